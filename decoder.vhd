@@ -0,0 +1,268 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+----------------------------------------------------------------------------------
+--
+-- protocol decoder: writes the bytes of a uart, an spi and an i2c bus instead
+-- of the samples (ENCODING_DECODED)
+--
+-- each engine is enabled by bit0 of its control register and takes its lines
+-- from any channel. they work on the samples, so the uart bit period is in
+-- samples and the sample rate must be a few times the bit rate of each bus.
+-- a record of four fifo words is written for each byte or event:
+--   word 0:   bit15-14: engine (0: uart, 1: spi, 2: i2c), bit13-8: flags,
+--             bit7-0: byte
+--             uart flags: bit8 framing error, bit9 parity error
+--             spi flags: bit8 miso byte (the mosi byte comes first), bit9
+--             first byte since cs went low. bit5 of the spi control register
+--             drops the miso records, for a bus without a miso line
+--             i2c flags: bit8 ack bit ('1': nack), bit9 start, bit10 stop
+--             (start and stop records have byte 0)
+--   word 1-3: number of the sample which completed the byte, 48 bits lsb
+--             first, counted from 0 at the start of the capture
+-- records are written in the order of the engines when they complete at
+-- the same time, so timestamps can go back by a few samples between
+-- engines. each engine has one record waiting while another one is written,
+-- if it completes the next one before that records are lost and overflow is
+-- strobed
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity decoder is
+    port(
+        clk             : in std_logic; -- sample clock
+        enable          : in std_logic; -- '1' to decode, '0' to reset
+        uart_control    : in std_logic_vector(7 downto 0); -- bit0: enable, bit2-1: parity (0: none, 1: even, 2: odd), bit7-4: rx channel, async (must only be changed while enable is inactive)
+        uart_bit_period : in std_logic_vector(15 downto 0); -- samples per bit, at least 2, async (same)
+        spi_control     : in std_logic_vector(7 downto 0); -- bit0: enable, bit1: cpol, bit2: cpha, bit3: lsb first, bit4: ignore cs, bit5: no miso records, async (same)
+        spi_channels    : in std_logic_vector(15 downto 0); -- bit3-0: sclk, bit7-4: cs, bit11-8: mosi, bit15-12: miso, async (same)
+        i2c_control     : in std_logic_vector(7 downto 0); -- bit0: enable, async (same)
+        i2c_channels    : in std_logic_vector(7 downto 0); -- bit3-0: scl, bit7-4: sda, async (same)
+        data_in         : in std_logic_vector(15 downto 0); -- sampled input word
+        data_valid      : in std_logic; -- data_in holds a new sample
+        fifo_data       : out std_logic_vector(15 downto 0) := (others=>'0'); -- data to fifo
+        fifo_write      : out std_logic := '0'; -- tell fifo to write data on next clock
+        overflow        : out std_logic := '0' -- strobed when a record was lost
+    );
+end decoder;
+
+
+architecture behavioral of decoder is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+    type vector16_arr_t is array (natural range <>) of vector16_t;
+    type stamp_arr_t is array (natural range <>) of unsigned(47 downto 0);
+
+    -- record slots
+    constant SLOT_UART : integer := 0;
+    constant SLOT_MOSI : integer := 1;
+    constant SLOT_MISO : integer := 2;
+    constant SLOT_I2C  : integer := 3;
+
+    -- lines, register'd from data_in
+    signal line_valid : std_logic := '0';
+    signal uart_line  : std_logic;
+    signal spi_sclk   : std_logic;
+    signal spi_cs_n   : std_logic;
+    signal spi_mosi   : std_logic;
+    signal spi_miso   : std_logic;
+    signal i2c_scl    : std_logic;
+    signal i2c_sda    : std_logic;
+    signal now        : unsigned(47 downto 0); -- number of the last sample on the lines
+
+    -- engines
+    signal uart_enable    : std_logic;
+    signal uart_data      : std_logic_vector(7 downto 0);
+    signal uart_flags     : std_logic_vector(1 downto 0);
+    signal uart_strobe    : std_logic;
+    signal spi_enable     : std_logic;
+    signal spi_use_cs     : std_logic;
+    signal spi_miso_on    : std_logic;
+    signal spi_mosi_data  : std_logic_vector(7 downto 0);
+    signal spi_miso_data  : std_logic_vector(7 downto 0);
+    signal spi_first      : std_logic;
+    signal spi_strobe     : std_logic;
+    signal i2c_enable     : std_logic;
+    signal i2c_data       : std_logic_vector(7 downto 0);
+    signal i2c_flags      : std_logic_vector(2 downto 0);
+    signal i2c_strobe     : std_logic;
+
+    -- records
+    signal slot_word    : vector16_arr_t(0 to 3);
+    signal slot_stamp   : stamp_arr_t(0 to 3);
+    signal slot_pending : std_logic_vector(0 to 3) := (others=>'0');
+    signal out_words    : vector16_arr_t(0 to 3); -- record being written
+    signal out_count    : unsigned(2 downto 0) := (others=>'0'); -- words left to write
+
+    attribute TIG : string;
+    attribute TIG of uart_control : signal is "TRUE";
+    attribute TIG of uart_bit_period : signal is "TRUE";
+    attribute TIG of spi_control : signal is "TRUE";
+    attribute TIG of spi_channels : signal is "TRUE";
+    attribute TIG of i2c_control : signal is "TRUE";
+    attribute TIG of i2c_channels : signal is "TRUE";
+
+begin
+
+    uart_enable <= enable and uart_control(0);
+    spi_enable <= enable and spi_control(0);
+    spi_use_cs <= not spi_control(4);
+    spi_miso_on <= not spi_control(5);
+    i2c_enable <= enable and i2c_control(0);
+
+    uart_rx_inst : entity work.uart_rx
+        port map(
+            clk        => clk,
+            enable     => uart_enable,
+            parity     => uart_control(2 downto 1),
+            bit_period => unsigned(uart_bit_period),
+            rx         => uart_line,
+            data_valid => line_valid,
+            data       => uart_data,
+            flags      => uart_flags,
+            strobe     => uart_strobe
+        );
+
+    spi_rx_inst : entity work.spi_rx
+        port map(
+            clk        => clk,
+            enable     => spi_enable,
+            cpol       => spi_control(1),
+            cpha       => spi_control(2),
+            lsb_first  => spi_control(3),
+            use_cs     => spi_use_cs,
+            sclk       => spi_sclk,
+            cs_n       => spi_cs_n,
+            mosi       => spi_mosi,
+            miso       => spi_miso,
+            data_valid => line_valid,
+            mosi_data  => spi_mosi_data,
+            miso_data  => spi_miso_data,
+            first      => spi_first,
+            strobe     => spi_strobe
+        );
+
+    i2c_rx_inst : entity work.i2c_rx
+        port map(
+            clk        => clk,
+            enable     => i2c_enable,
+            scl        => i2c_scl,
+            sda        => i2c_sda,
+            data_valid => line_valid,
+            data       => i2c_data,
+            flags      => i2c_flags,
+            strobe     => i2c_strobe
+        );
+
+    -- pick the lines from the input word, one clock for the 16:1 muxes
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            line_valid <= data_valid and enable;
+            uart_line <= data_in(to_integer(unsigned(uart_control(7 downto 4))));
+            spi_sclk <= data_in(to_integer(unsigned(spi_channels(3 downto 0))));
+            spi_cs_n <= data_in(to_integer(unsigned(spi_channels(7 downto 4))));
+            spi_mosi <= data_in(to_integer(unsigned(spi_channels(11 downto 8))));
+            spi_miso <= data_in(to_integer(unsigned(spi_channels(15 downto 12))));
+            i2c_scl <= data_in(to_integer(unsigned(i2c_channels(3 downto 0))));
+            i2c_sda <= data_in(to_integer(unsigned(i2c_channels(7 downto 4))));
+            -- the engines strobe one clock after line_valid, now is still the
+            -- number of that sample then
+            if (line_valid = '1') then
+                now <= now + 1;
+            end if;
+            if (enable = '0') then
+                now <= (others=>'1');
+            end if;
+        end if;
+    end process;
+
+    -- write the records
+    process(clk)
+        variable strobes : std_logic_vector(0 to 3);
+        variable words   : vector16_arr_t(0 to 3);
+        variable free    : std_logic_vector(0 to 3);
+        variable pending : std_logic_vector(0 to 3);
+    begin
+        if rising_edge(clk) then
+            fifo_write <= '0';
+            overflow <= '0';
+
+            -- one word per clock
+            if (out_count /= 0) then
+                fifo_data <= out_words(0);
+                fifo_write <= '1';
+                out_words <= out_words(1 to 3) & x"0000";
+                out_count <= out_count - 1;
+            end if;
+
+            -- take the next record while the last word is written
+            pending := slot_pending;
+            free := not slot_pending;
+            if (out_count <= 1) then
+                for i in 3 downto 0 loop
+                    if (slot_pending(i) = '1') then
+                        out_words <= (slot_word(i),
+                                      std_logic_vector(slot_stamp(i)(15 downto 0)),
+                                      std_logic_vector(slot_stamp(i)(31 downto 16)),
+                                      std_logic_vector(slot_stamp(i)(47 downto 32)));
+                        pending := slot_pending;
+                        pending(i) := '0';
+                        free := not pending;
+                    end if;
+                end loop;
+                if (slot_pending /= "0000") then
+                    out_count <= to_unsigned(4, out_count'length);
+                end if;
+            end if;
+
+            -- new records from the engines
+            strobes := (uart_strobe, spi_strobe, spi_strobe and spi_miso_on, i2c_strobe);
+            words(SLOT_UART) := "00" & "0000" & uart_flags & uart_data;
+            words(SLOT_MOSI) := "01" & "0000" & spi_first & '0' & spi_mosi_data;
+            words(SLOT_MISO) := "01" & "0000" & spi_first & '1' & spi_miso_data;
+            words(SLOT_I2C) := "10" & "000" & i2c_flags & i2c_data;
+            for i in 0 to 3 loop
+                if (strobes(i) = '1') then
+                    if (free(i) = '1') then
+                        slot_word(i) <= words(i);
+                        slot_stamp(i) <= now;
+                        pending(i) := '1';
+                    else
+                        overflow <= '1';
+                    end if;
+                end if;
+            end loop;
+            slot_pending <= pending;
+
+            -- reset
+            if (enable = '0') then
+                slot_pending <= (others=>'0');
+                out_count <= (others=>'0');
+                fifo_write <= '0';
+            end if;
+        end if;
+    end process;
+
+end behavioral;
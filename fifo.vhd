@@ -25,6 +25,11 @@
 -- multiple block rams are used which are filled one after the other and sent to
 -- the read domain where they are consumed and sent back to the write domain
 --
+-- while hold is '1' filled block rams are kept in the write domain instead, up
+-- to hold_limit of them. when one more is filled the oldest one is dropped, so
+-- the last hold_limit block rams before hold is released are sent to the read
+-- domain (hold must only be set while the fifo is reset)
+--
 -- WARNING: the block ram acts strange so the input data must 
 --          be valid until 1 cylcle after the write!
 --
@@ -53,7 +58,11 @@ entity fifo is
         enable_read  : in std_logic;
         enable_write : in std_logic;
         data_out     : out std_logic_vector(15 downto 0);
-        data_in      : in std_logic_vector(15 downto 0)
+        data_in      : in std_logic_vector(15 downto 0);
+        hold         : in std_logic := '0'; -- keep filled rams from the read domain (sync'd to write clock)
+        hold_limit   : in unsigned(ram_count_log2-1 downto 0) := (others=>'1'); -- number of rams kept while holding
+        dropped      : out unsigned(15 downto 0); -- number of rams dropped while holding (cleared when reset ends)
+        level        : out unsigned(15 downto 0) -- words not free for writing (sync'd to write clock)
     );
 end fifo;
 
@@ -76,6 +85,7 @@ architecture behavioral of fifo is
     signal ram_in_read_domain      : unsigned(ram_count_log2 downto 0);
     signal ram_in_read_domain_get  : std_logic;
     signal ram_in_write_domain_set : std_logic := '0';
+    signal ram_skip_get            : std_logic;
     signal ram_enable_read         : vector_t;
     signal ram_read_addr           : addr_t;
     signal ram_read_end            : std_logic;
@@ -96,6 +106,10 @@ architecture behavioral of fifo is
     signal ram_write_addr          : addr_t;
     signal ram_write_addr_at_end   : std_logic;
     signal ram_data_in             : vector16_t;
+    signal ram_skip_set            : std_logic := '0';
+    signal ram_held                : unsigned(ram_count_log2 downto 0); -- filled rams kept in write domain
+    signal ram_release_delay       : unsigned(2 downto 0); -- space flags to the read domain while releasing
+    signal dropped_int             : unsigned(15 downto 0);
 
     signal will_read_data_out : boolean;
     signal want_read_data_out_reg : boolean;
@@ -147,11 +161,22 @@ begin
             input      => ram_in_write_domain_set,
             output     => ram_in_write_domain_get
         );
+    flag_ram3_inst : entity work.syncflag
+        port map(
+            clk_input  => clk_write,
+            clk_output => clk_read,
+            input      => ram_skip_set,
+            output     => ram_skip_get
+        );
 
     empty <= not data_out_valid;
     almost_empty <= (not data_out_valid) or
                     (data_out_valid and not (data_out_reg_valid or ram_data_out_valid));
     full <= full_int;
+    dropped <= dropped_int;
+    -- all rams not in the write domain plus the words written to the current one
+    level <= shift_left(resize(to_unsigned(2**ram_count_log2, ram_count_log2+1) - ram_in_write_domain, 16), ram_size_log2) +
+             resize(ram_write_addr + 1, 16);
     --data_out <= ram_data_out(to_integer(ram_read_index));
 
     -- synchronize reset signals
@@ -268,6 +293,10 @@ begin
             if (ram_in_read_domain_get = '1') then
                 ram_in_read_domain_inc := true;
             end if;
+            if (ram_skip_get = '1') then
+                -- ram was dropped while holding, nothing is read while holding
+                ram_read_index <= ram_read_index + 1;
+            end if;
             
             -- increment or decrement ram count if needed
             if ram_in_read_domain_inc and not ram_in_read_domain_dec then
@@ -299,13 +328,18 @@ begin
     process(clk_write)
         variable ram_in_write_domain_inc : boolean;
         variable ram_in_write_domain_dec : boolean;
+        variable ram_held_inc : boolean;
+        variable ram_held_dec : boolean;
     begin
         ram_in_write_domain_inc := false;
         ram_in_write_domain_dec := false;
+        ram_held_inc := false;
+        ram_held_dec := false;
         if rising_edge(clk_write) then
             -- default value for signals
             reset_read_set <= '0';
             ram_in_read_domain_set <= '0';
+            ram_skip_set <= '0';
             ram_enable_write <= (others=>'0');
             
             -- write data to ram
@@ -323,12 +357,34 @@ begin
                 end if;
                 if (ram_write_addr_at_end = '1') then
                     -- ram is filled with this clock cycle
-                    ram_in_read_domain_set <= '1';
-                    ram_in_write_domain_dec := true;
                     ram_write_index <= ram_write_index + 1;
-                    full_int <= '1';
+                    if (hold = '1') and ((ram_held >= hold_limit) or (ram_in_write_domain = 1)) then
+                        -- drop oldest held ram (this one if none is held) and write to it next
+                        ram_skip_set <= '1';
+                        ram_release_delay <= (others=>'1');
+                        dropped_int <= dropped_int + 1;
+                        almost_full <= '0';
+                    elsif (hold = '1') or (ram_held /= 0) or (ram_release_delay /= 0) then
+                        -- keep ram (behind the held ones) until hold is released
+                        ram_held_inc := true;
+                        ram_in_write_domain_dec := true;
+                        full_int <= '1';
+                    else
+                        ram_in_read_domain_set <= '1';
+                        ram_in_write_domain_dec := true;
+                        full_int <= '1';
+                    end if;
                 end if;
             end if;
+            
+            -- pass held rams to the read domain one by one when hold is released
+            if (ram_release_delay /= 0) then
+                ram_release_delay <= ram_release_delay - 1;
+            elsif (hold = '0') and (ram_held /= 0) then
+                ram_in_read_domain_set <= '1';
+                ram_held_dec := true;
+                ram_release_delay <= (others=>'1');
+            end if;
             -- don't set full/almost_full flag if next ram block is in write domain
             if (ram_in_write_domain > 1) then
                 full_int <= '0';
@@ -348,9 +404,18 @@ begin
             elsif ram_in_write_domain_dec and not ram_in_write_domain_inc then
                 ram_in_write_domain <= ram_in_write_domain - 1;
             end if;
+            if ram_held_inc and not ram_held_dec then
+                ram_held <= ram_held + 1;
+            elsif ram_held_dec and not ram_held_inc then
+                ram_held <= ram_held - 1;
+            end if;
 
             -- reset
             reset_last <= reset;
+            if (reset_last = '1') and (reset = '0') then
+                -- start of new run
+                dropped_int <= (others=>'0');
+            end if;
             if (reset_last = '0') and (reset = '1') then
                 -- tell read domain to reset
                 reset_read_set <= '1';
@@ -368,8 +433,11 @@ begin
                 ram_in_write_domain <= to_unsigned(2**ram_count_log2, ram_in_write_domain'length);
                 ram_write_addr <= (others=>'1');
                 ram_write_addr_at_end <= '0';
+                ram_held <= (others=>'0');
+                ram_release_delay <= (others=>'0');
                 -- default value for signals
                 ram_in_read_domain_set <= '0';
+                ram_skip_set <= '0';
                 ram_enable_write <= (others=>'0');
             end if;
         end if;
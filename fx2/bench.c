@@ -0,0 +1,379 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * cycle benchmark of the firmware in the ucsim 8051 simulator, replaces
+ * fw.c in the bench build ("make bench-fx2")
+ *
+ * there is no usb and no fpga in the simulator, the fx2 registers are plain
+ * xdata and sfr memory. the benchmark plays the host: it puts each command
+ * into EP1OUTBUF, marks ep1 out as not busy and counts the cycles of one
+ * main_loop() with timer 0. the bitstream upload is measured the same way
+ * with full ep6 packets. the results are printed on the serial port, which
+ * the simulator writes to a file
+ *
+ * the cycles are those of the simulated 8052, which does not have the
+ * faster cycle timing of the fx2 core, so the numbers are for comparing
+ * firmware versions. bytes/s assume 12M cycles/s (48MHz, 4 clocks per
+ * cycle). the eeprom commands are not measured, they need an i2c slave
+ */
+
+#include <fx2macros.h>
+#include <fx2ints.h>
+
+extern void main_loop();
+extern void main_init();
+
+#define CMD_START_ACQUISITION        0x01
+#define CMD_ABORT_ACQUISITION_ASYNC  0x02
+#define CMD_WRITE_LED_TABLE          0x7a
+#define CMD_SET_LED_MODE             0x7b
+#define CMD_ABORT_ACQUISITION_SYNC   0x7d
+#define CMD_FPGA_UPLOAD_INIT         0x7e
+#define CMD_FPGA_UPLOAD_DATA         0x7f
+#define CMD_FPGA_WRITE_REGISTER      0x80
+#define CMD_FPGA_READ_REGISTER       0x81
+#define CMD_GET_REVID                0x82
+#define CMD_FPGA_GET_STATUS          0x83
+#define CMD_SET_EP2_PROFILE          0x84
+#define CMD_SET_GPIF_FLOW            0x85
+
+#define CYCLES_PER_SECOND  12000000
+#define UPLOAD_PACKETS     8
+#define UPLOAD_PACKET_SIZE 512
+
+static volatile WORD timer_overflows;
+static WORD timer_overhead;
+static __xdata BYTE cmd[64];
+
+
+void
+timer0_isr() __interrupt TF0_ISR
+{
+    timer_overflows++;
+}
+
+
+static void
+timer_start()
+{
+    TR0 = 0;
+    TH0 = 0;
+    TL0 = 0;
+    timer_overflows = 0;
+    TR0 = 1;
+}
+
+
+static DWORD
+timer_stop()
+{
+    TR0 = 0;
+    return (((DWORD)timer_overflows << 16) | ((WORD)TH0 << 8) | TL0) - timer_overhead;
+}
+
+
+static void
+put_char(char c)
+{
+    while (!TI);
+    TI = 0;
+    SBUF0 = c;
+}
+
+
+static void
+put_str(const char *s)
+{
+    while (*s)
+        put_char(*s++);
+}
+
+
+/* decimal, right aligned in width characters */
+static void
+put_dec(DWORD v, BYTE width)
+{
+    char buf[11];
+    BYTE n = 0;
+    do
+    {
+        buf[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v > 0);
+    while (width-- > n)
+        put_char(' ');
+    while (n > 0)
+        put_char(buf[--n]);
+}
+
+
+static void
+put_hex(BYTE v)
+{
+    static const char digits[] = "0123456789abcdef";
+    put_str("0x");
+    put_char(digits[v >> 4]);
+    put_char(digits[v & 15]);
+}
+
+
+/* name and cycles of one result line */
+static void
+put_result(const char *name, DWORD cycles)
+{
+    BYTE n = 0;
+    while (name[n])
+        put_char(name[n++]);
+    while (n++ < 32)
+        put_char(' ');
+    put_dec(cycles, 10);
+    put_str("\r\n");
+}
+
+
+/* ep1 encode, same as the host side (ep1_encrypt in logic16.c) */
+static void
+ep1_encode(BYTE *dst, BYTE *src, BYTE count)
+{
+    BYTE st[2] = {0x9b, 0x54};
+    while (count-- > 0)
+    {
+        BYTE s, x;
+        s = *src++;
+        x = (((s ^ st[1] ^ 0x2b) - 0x05) ^ 0x35) - 0x39;
+        x = (((x ^ st[0] ^ 0x5a) - 0xb0) ^ 0x38) - 0x45;
+        *dst++ = x;
+        st[0] = s;
+        st[1] = x;
+    }
+}
+
+
+/* cycles of one main_loop() with nothing to do but ep6 and the led timer */
+static DWORD
+bench_loop()
+{
+    EP1OUTCS = bmEPBUSY; /* no command */
+    EP1INCS = 0;
+    GPIFTRIG = (1<<7); /* gpif idle */
+    timer_start();
+    main_loop();
+    return timer_stop();
+}
+
+
+/* cycles of one main_loop() which handles the command in cmd */
+static void
+bench_command(const char *name, BYTE len)
+{
+    DWORD cycles;
+
+    ep1_encode(EP1OUTBUF, cmd, len);
+    EP1OUTBC = len;
+    EP1OUTCS = 0; /* packet received */
+    EP1INCS = 0;
+    EP2468STAT = bmEP6EMPTY;
+    GPIFTRIG = (1<<7);
+    timer_start();
+    main_loop();
+    cycles = timer_stop();
+    EP1OUTCS = bmEPBUSY;
+
+    put_hex(cmd[0]);
+    put_char(' ');
+    put_result(name, cycles);
+}
+
+
+/* bytes per second for cycles */
+static DWORD
+rate(DWORD bytes, DWORD cycles)
+{
+    /* bytes * 12M overflows, scale both down */
+    while (bytes > 255)
+    {
+        bytes >>= 1;
+        cycles >>= 1;
+    }
+    if (cycles == 0)
+        return 0;
+    return bytes * (CYCLES_PER_SECOND / 256) / cycles * 256;
+}
+
+
+/*
+ * feed UPLOAD_PACKETS full packets to the ep6 upload, compressed: with
+ * runs and literals of about the ratio of a real bitstream (4.3:1)
+ */
+static void
+bench_upload(BOOL compressed)
+{
+    DWORD cycles = 0, bytes = 0;
+    BYTE p;
+    WORD i;
+
+    cmd[0] = CMD_FPGA_UPLOAD_INIT;
+    cmd[1] = cmd[2] = cmd[3] = cmd[4] = 0xff; /* never ends */
+    cmd[5] = compressed ? 1 : 0;
+    bench_command(compressed ? "FPGA_UPLOAD_INIT (ep6, rle)" : "FPGA_UPLOAD_INIT (ep6)", 6);
+
+    for (p = 0; p < UPLOAD_PACKETS; p++)
+    {
+        for (i = 0; i < UPLOAD_PACKET_SIZE; i++)
+            EP6FIFOBUF[i] = i;
+        if (compressed)
+        {
+            /* 64 byte units: 59 literals, two runs of 108: 275 bytes */
+            for (i = 0; i < UPLOAD_PACKET_SIZE; i += 64)
+            {
+                EP6FIFOBUF[i] = 59 - 1;
+                EP6FIFOBUF[i + 60] = 0x80 | (108 - 3);
+                EP6FIFOBUF[i + 61] = 0x00;
+                EP6FIFOBUF[i + 62] = 0x80 | (108 - 3);
+                EP6FIFOBUF[i + 63] = 0xff;
+            }
+            bytes += UPLOAD_PACKET_SIZE / 64 * 275;
+        }
+        else
+        {
+            bytes += UPLOAD_PACKET_SIZE;
+        }
+        EP6BCH = MSB(UPLOAD_PACKET_SIZE);
+        EP6BCL = LSB(UPLOAD_PACKET_SIZE);
+        EP2468STAT = 0; /* ep6 has a packet */
+        cycles += bench_loop();
+        EP2468STAT = bmEP6EMPTY;
+    }
+
+    put_str(compressed ? "upload rle: " : "upload: ");
+    put_dec(bytes, 0);
+    put_str(" bitstream bytes in ");
+    put_dec(cycles, 0);
+    put_str(" cycles, ");
+    put_dec(rate(bytes, cycles), 0);
+    put_str(" bytes/s\r\n");
+}
+
+
+/* the simulator stops here, "make bench-fx2" sets a breakpoint */
+void
+bench_done()
+{
+    while (TRUE);
+}
+
+
+void
+main()
+{
+    BYTE i;
+
+    /* serial port for the results, timer 1 as baud rate generator, timer
+     * 0 counts cycles */
+    TMOD = 0x21;
+    TH1 = 0xff;
+    TR1 = 1;
+    SCON0 = 0x50;
+    TI = 1;
+    ET0 = 1;
+    EA = 1;
+
+    timer_overhead = 0;
+    timer_start();
+    timer_overhead = timer_stop();
+
+    GPIFTRIG = (1<<7);
+    main_init();
+    /* the led timer only runs when measured */
+    TR2 = 0;
+    TF2 = 0;
+
+    put_str("la16fw fx2 benchmark, cycles of one main_loop()\r\n");
+
+    put_result("     idle", bench_loop());
+
+    cmd[0] = CMD_START_ACQUISITION;
+    bench_command("START_ACQUISITION", 1);
+    cmd[0] = CMD_ABORT_ACQUISITION_ASYNC;
+    bench_command("ABORT_ACQUISITION_ASYNC", 1);
+    cmd[0] = CMD_ABORT_ACQUISITION_SYNC;
+    cmd[1] = 0x55;
+    bench_command("ABORT_ACQUISITION_SYNC", 2);
+
+    cmd[0] = CMD_WRITE_LED_TABLE;
+    cmd[1] = 0;
+    cmd[2] = 60;
+    for (i = 0; i < 60; i++)
+        cmd[3 + i] = i;
+    bench_command("WRITE_LED_TABLE (60)", 63);
+    cmd[0] = CMD_SET_LED_MODE;
+    cmd[1] = 1; /* run */
+    cmd[2] = 0;
+    cmd[3] = 0;
+    cmd[4] = 0; /* div */
+    cmd[5] = 1; /* repeat */
+    bench_command("SET_LED_MODE", 6);
+    TF2 = 1;
+    put_result("     led timer", bench_loop());
+
+    /* 8 consecutive registers and 8 scattered ones */
+    cmd[0] = CMD_FPGA_WRITE_REGISTER;
+    cmd[1] = 16;
+    for (i = 0; i < 16; i++)
+    {
+        cmd[2 + 2*i] = i < 8 ? 96 + i : 2*i;
+        cmd[3 + 2*i] = i;
+    }
+    bench_command("FPGA_WRITE_REGISTER (16)", 34);
+    cmd[0] = CMD_FPGA_READ_REGISTER;
+    cmd[1] = 16;
+    for (i = 0; i < 16; i++)
+        cmd[2 + i] = i < 8 ? 25 + i : 2*i;
+    bench_command("FPGA_READ_REGISTER (16)", 18);
+    PA0 = 1; /* DONE */
+    cmd[0] = CMD_FPGA_GET_STATUS;
+    bench_command("FPGA_GET_STATUS", 1);
+    PA0 = 0;
+
+    cmd[0] = CMD_SET_EP2_PROFILE;
+    cmd[1] = 0;
+    bench_command("SET_EP2_PROFILE", 2);
+    cmd[0] = CMD_SET_GPIF_FLOW;
+    cmd[1] = 1;
+    bench_command("SET_GPIF_FLOW", 2);
+    cmd[0] = CMD_GET_REVID;
+    bench_command("GET_REVID (stall)", 1);
+
+    cmd[0] = CMD_FPGA_UPLOAD_INIT;
+    bench_command("FPGA_UPLOAD_INIT", 1);
+    cmd[0] = CMD_FPGA_UPLOAD_DATA;
+    cmd[1] = 62;
+    for (i = 0; i < 62; i++)
+        cmd[2 + i] = i;
+    bench_command("FPGA_UPLOAD_DATA (62)", 64);
+
+    bench_upload(FALSE);
+    bench_upload(TRUE);
+
+    put_str("done\r\n");
+    while (!TI); /* last character sent */
+    bench_done();
+}
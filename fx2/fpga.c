@@ -77,6 +77,10 @@
 
 static BOOL fpga_upload_done;
 
+/* rle decoder state, tokens may span packets */
+static BYTE rle_count; /* bytes left of the current token, 0: next byte is a token */
+static BOOL rle_run; /* current token is a run, next byte is its value */
+
 
 void
 fpga_init()
@@ -114,6 +118,8 @@ fpga_upload_init()
     GPIFIDLECTL |= PROG_B;
     
     fpga_upload_done = FALSE;
+    rle_count = 0;
+    rle_run = FALSE;
 
     /* wait for init_b */
     while (--timeout > 0 && !(INIT_B_IO & INIT_B)) delay(1);
@@ -124,6 +130,15 @@ fpga_upload_init()
 }
 
 
+/*
+ * shift len bytes from autopointer 1 out to the fpga, msb first
+ *
+ * unrolled. counted from the instruction table of the fx2 trm (not
+ * measured, "make bench-fx2" gives the cycles of the upload commands) each
+ * bit takes 7 cycles (rlc 1, mov bit 2, setb 2, clr 2) and each byte 61
+ * cycles with movx and djnz, 5us at 48MHz. the previous loop with a jump
+ * for DIN and djnz per bit counts up to 127 cycles per byte
+ */
 static void
 fpga_upload_data_fast(BYTE len)
 {
@@ -133,38 +148,151 @@ fpga_upload_data_fast(BYTE len)
     mov  r2, dpl
     mov  dptr, #_XAUTODAT1
     00001$:
-        mov  r3, #8
         movx a, @dptr
-    00002$:
-        rlc  a
-        __endasm;
-        DIN_BIT = FALSE;
-        __asm
-        jnc  00003$
-        __endasm;
-        DIN_BIT = TRUE;
-        __asm
-    00003$:
+        rlc  a            ; bit 7
+        mov  _PA3, c      ; DIN
+        setb _PA2         ; CCLK
+        clr  _PA2
+        rlc  a            ; bit 6
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 5
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 4
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 3
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 2
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 1
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 0
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        djnz r2, 00001$
     __endasm;
-        DELAY_CONFIG;
-        CCLK_BIT = TRUE;
-        DELAY_CONFIG;
-        CCLK_BIT = FALSE;
-        //if (DONE_BIT || !INIT_B_BIT)
-        //    return;
+}
+
+
+
+static BYTE fpga_repeat_value;
+
+/*
+ * shift fpga_repeat_value out to the fpga len times, msb first
+ *
+ * same timing as fpga_upload_data_fast, for the runs of compressed
+ * bitstreams
+ */
+static void
+fpga_upload_repeat_fast(BYTE len)
+{
+    /* len in dpl */
+    (void)len;
     __asm
-        djnz r3, 00002$
+    mov  r2, dpl
+    00001$:
+        mov  a, _fpga_repeat_value
+        rlc  a            ; bit 7
+        mov  _PA3, c      ; DIN
+        setb _PA2         ; CCLK
+        clr  _PA2
+        rlc  a            ; bit 6
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 5
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 4
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 3
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 2
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 1
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
+        rlc  a            ; bit 0
+        mov  _PA3, c
+        setb _PA2
+        clr  _PA2
         djnz r2, 00001$
     __endasm;
 }
 
 
-
+/* DONE is high while the fpga holds a configuration */
 BOOL
-fpga_upload_data(BYTE *data, BYTE len)
+fpga_is_configured()
+{
+    return DONE_BIT;
+}
+
+
+/* check the configuration pins after shifting data, FALSE on error */
+static BOOL
+fpga_upload_check()
+{
+    DIN_BIT = FALSE;
+    if (DONE_BIT)
+        fpga_upload_done = TRUE;
+    return fpga_upload_done || INIT_B_BIT;
+}
+
+
+/* clock the fpga after the last block until it's done */
+static BOOL
+fpga_upload_finish()
 {
-    const BOOL last = len < 62; // FIXME: find better way of detecting end of data
+    WORD timeout = 1000;
+    BYTE b;
+    while (--timeout > 0)
+    {
+        if (DONE_BIT)
+        {
+            fpga_upload_done = TRUE;
+            return TRUE;
+        }
+        if (!INIT_B_BIT)
+            return FALSE;
 
+        b = 255;
+        while (b-- > 0)
+        {
+            DELAY_CONFIG;
+            CCLK_BIT = TRUE;
+            DELAY_CONFIG;
+            CCLK_BIT = FALSE;
+        }
+    }
+    return FALSE;
+}
+
+
+/* last must be TRUE for the last block of the bitstream */
+BOOL
+fpga_upload_data(BYTE *data, BYTE len, BOOL last)
+{
     if (fpga_upload_done || len <= 0)
         return TRUE;
 
@@ -173,13 +301,6 @@ fpga_upload_data(BYTE *data, BYTE len)
     AUTOPTRL1 = LSB(data);
     #if 1
     fpga_upload_data_fast(len);
-    if (DONE_BIT)
-    {
-        fpga_upload_done = TRUE;
-        return TRUE;
-    }
-    if (!INIT_B_BIT)
-        return FALSE;
     #else
     while (len-- > 0)
     {
@@ -207,84 +328,162 @@ fpga_upload_data(BYTE *data, BYTE len)
         while (--bit > 0);
     }
     #endif
-    DIN_BIT = FALSE;
+    if (!fpga_upload_check())
+        return FALSE;
     
     if (last && !fpga_upload_done)
+        return fpga_upload_finish();
+    
+    return TRUE;
+}
+
+
+/*
+ * upload len bytes of an rle compressed bitstream, last must be TRUE for
+ * the last block
+ *
+ * a token byte 0x00-0x7f is followed by 1-128 literal bytes, a token byte
+ * 0x80-0xff by one byte which is repeated 3-130 times (see host/rlepack.c).
+ * literals are shifted out straight from data and runs from a register, so
+ * nothing is decompressed into memory
+ */
+BOOL
+fpga_upload_rle(BYTE *data, WORD len, BOOL last)
+{
+    while (len > 0 && !fpga_upload_done)
     {
-        WORD timeout = 1000;
-        BYTE b;
-        while (--timeout > 0)
+        if (rle_count == 0)
+        {
+            BYTE token = *data++;
+            len--;
+            rle_run = (token & 0x80) != 0;
+            rle_count = rle_run ? (token & 0x7f) + 3 : token + 1;
+            continue;
+        }
+        if (rle_run)
         {
-            if (DONE_BIT)
-            {
-                fpga_upload_done = TRUE;
-                break;
-            }
-            if (!INIT_B_BIT)
-                return FALSE;
-
-            b = 255;
-            while (b-- > 0)
-            {
-                DELAY_CONFIG;
-                CCLK_BIT = TRUE;
-                DELAY_CONFIG;
-                CCLK_BIT = FALSE;
-            }
+            fpga_repeat_value = *data++;
+            len--;
+            fpga_upload_repeat_fast(rle_count);
+            rle_count = 0;
         }
-        if (timeout == 0)
+        else
+        {
+            BYTE n = rle_count;
+            if (n > len)
+                n = len;
+            AUTOPTRSETUP = 0x02; /* inc ptr 1 */
+            AUTOPTRH1 = MSB(data);
+            AUTOPTRL1 = LSB(data);
+            fpga_upload_data_fast(n);
+            data += n;
+            len -= n;
+            rle_count -= n;
+        }
+        if (!fpga_upload_check())
             return FALSE;
     }
-    
+
+    if (last && !fpga_upload_done)
+    {
+        /* truncated token */
+        if (rle_count != 0)
+            return FALSE;
+        return fpga_upload_finish();
+    }
+
     return TRUE;
 }
 
 
-static BYTE
-spi_transfer(BYTE addr, BYTE val)
+static void
+spi_select()
 {
-    BYTE i = 2, b = addr, ret = 0;
     SS_N_IO &= ~SS_N;
     DELAY_SPI;
-    
-    while (i-- > 0)
-    {
-        BYTE bit = 8;
-        while (bit-- > 0)
-        {
-            if (b & (1<<7))
-                MOSI_IO |= MOSI;
-            else
-                MOSI_IO &= ~MOSI;
-            b <<= 1;
-            DELAY_SPI;
-            SCLK_IO |= SCLK;
-            DELAY_SPI;
-            SCLK_IO &= ~SCLK;
-            ret <<= 1;
-            if (MISO_IO & MISO)
-                ret |= (1<<0);
-        }
-        b = val;
-    }
+}
 
+
+static void
+spi_deselect()
+{
     DELAY_SPI;
     SS_N_IO |= SS_N;
-    
-    return ret;
+}
+
+
+static BYTE spi_result;
+
+/*
+ * shift one byte out on mosi and in from miso, msb first
+ *
+ * counted from the instruction table of the fx2 trm (not measured) the
+ * loop takes 12 cycles per bit (rlc 1, mov bit 2, setb 2, clr 2, mov c 2,
+ * djnz 3), i.e. 1us at 48MHz. the c loop it replaces spent 16 cycles per
+ * bit in DELAY_SPI alone plus an estimated 25 more for the shifts, the
+ * read-modify-write of IOA and the loop, about 3.5us per bit.
+ * sclk is high for 2 and low for 8 cycles, the fpga needs 3 of its
+ * clocks (63ns) to see each level. miso is read after the falling edge,
+ * it was set on the rising edge (spi.vhd), which is 2 cycles before
+ */
+static BYTE
+spi_transfer_byte(BYTE b)
+{
+    /* b in dpl */
+    (void)b;
+    __asm
+    mov  a, dpl
+    mov  r7, #8
+    00001$:
+        rlc  a            ; msb to carry, miso bit from last round to lsb
+        mov  _PA6, c      ; MOSI
+        setb _PA5         ; SCLK
+        clr  _PA5
+        mov  c, _PA7      ; MISO
+        djnz r7, 00001$
+    rlc  a
+    mov  _spi_result, a
+    __endasm;
+    return spi_result;
 }
 
 
 void
 fpga_write_reg(BYTE addr, BYTE val)
 {
-    spi_transfer(addr & ~(1<<7), val);
+    fpga_write_regs(addr, &val, 1);
 }
 
 
 BYTE
 fpga_read_reg(BYTE addr)
 {
-    return spi_transfer(addr | (1<<7), 0);
+    BYTE val;
+    fpga_read_regs(addr, &val, 1);
+    return val;
+}
+
+
+/* write count registers starting at addr in one spi burst */
+void
+fpga_write_regs(BYTE addr, BYTE *vals, BYTE count)
+{
+    spi_select();
+    spi_transfer_byte(addr & ~(1<<7));
+    while (count-- > 0)
+        spi_transfer_byte(*vals++);
+    spi_deselect();
+}
+
+
+/* read count registers starting at addr in one spi burst */
+void
+fpga_read_regs(BYTE addr, BYTE *vals, BYTE count)
+{
+    spi_select();
+    spi_transfer_byte(addr | (1<<7));
+    while (count-- > 0)
+        *vals++ = spi_transfer_byte(0);
+    spi_deselect();
 }
 
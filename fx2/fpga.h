@@ -25,8 +25,16 @@
 
 void fpga_init();
 BOOL fpga_upload_init();
-BOOL fpga_upload_data(BYTE *data, BYTE len);
+BOOL fpga_is_configured();
+BOOL fpga_upload_data(BYTE *data, BYTE len, BOOL last);
+BOOL fpga_upload_rle(BYTE *data, WORD len, BOOL last);
 void fpga_write_reg(BYTE addr, BYTE val);
 BYTE fpga_read_reg(BYTE addr);
+void fpga_write_regs(BYTE addr, BYTE *vals, BYTE count);
+void fpga_read_regs(BYTE addr, BYTE *vals, BYTE count);
+
+/* fpga registers used by the fx2 */
+#define FPGA_ADDRESS_VERSION       0
+#define FPGA_ADDRESS_BITSTREAM_ID  48 /* 4 bytes: io standard, build hash lsb first */
 
 #endif /* FPGA_H */
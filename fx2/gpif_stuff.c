@@ -32,6 +32,7 @@
 
 
 #define FPGA_READ_DATA  (1<<0)  // ctl0
+#define PROG_B_CTL      (1<<2)  // ctl2, see fpga.c
 
 #define GPIF_TRANSACTION_COUNT  256  // 512 bytes
 
@@ -72,6 +73,43 @@ static const BYTE __xdata WaveData_FIFORead[32] =
 /* Output*/ 0x05,     0x04,     0x04,     0x04,     0x04,     0x04,     0x04,     0x05,
 /* LFun  */ 0x70,     0x2D,     0x00,     0x00,     0x00,     0x00,     0x00,     0x3F,
 };
+
+// GPIF Waveform 2: FIFO Read with flowstate
+//
+// Interval     0         1         2         3         4         5         6     Idle (7)
+//          _________ _________ _________ _________ _________ _________ _________ _________
+//
+// AddrMode Same Val  Same Val  Same Val  Same Val  Same Val  Same Val  Same Val
+// DataMode NO Data   Activate  NO Data   NO Data   NO Data   NO Data   NO Data
+// NextData SameData  SameData  SameData  SameData  SameData  SameData  SameData
+// Int Trig No Int    No Int    No Int    No Int    No Int    No Int    No Int
+// IF/Wait  IF        IF (flow) Wait 1    Wait 1    Wait 1    Wait 1    Wait 1
+//   Term A FIFOFull  TCXpire
+//   LFunc  OR        AND
+//   Term B FPGA RDY  TCXpire
+// Branch1  Then 0    ThenIdle
+// Branch0  Else 1    Else 1
+// Re-Exec  Yes       Yes
+// Sngl/CRC Default   Default   Default   Default   Default   Default   Default
+// READ_N       1      (flow)       1         1         1         1         1         1
+// CTL1         0      (flow)       0         0         0         0         0         0
+// PROG_B       1         1         1         1         1         1         1         1
+// CTL3         0         0         0         0         0         0         0         0
+// CTL4         0         0         0         0         0         0         0         0
+// CTL5         0         0         0         0         0         0         0         0
+//
+// interval 1 is the flow state (see gpif_stuff_set_flow()): it reads one word
+// per clock while the flow logic (FIFOFull OR FPGA RDY) is false and holds
+// READ_N high while it is true. the fpga sets RDY early enough that the reads
+// in flight when it goes high still find data (readahead.vhd)
+
+static const BYTE __xdata WaveData_FIFOReadFlow[32] =
+{
+/* LenBr */ 0x81,     0xB9,     0x01,     0x01,     0x01,     0x01,     0x01,     0x07,
+/* Opcode*/ 0x01,     0x03,     0x00,     0x00,     0x00,     0x00,     0x00,     0x00,
+/* Output*/ 0x05,     0x04,     0x05,     0x05,     0x05,     0x05,     0x05,     0x05,
+/* LFun  */ 0x70,     0x2D,     0x00,     0x00,     0x00,     0x00,     0x00,     0x3F,
+};
 static const BYTE __xdata WaveData_Unused[32] =     
 {                                      
 /* LenBr */ 0x01,     0x01,     0x01,     0x01,     0x01,     0x01,     0x01,     0x07,
@@ -82,6 +120,31 @@ static const BYTE __xdata WaveData_Unused[32] =
 
 
 static BOOL gpif_active = FALSE;
+static BOOL gpif_flow = FALSE; /* flowstate not yet verified on the bus */
+
+
+/*
+ * ep2 buffering profiles, see gpif_stuff_set_profile()
+ *
+ * more and bigger buffers bridge longer gaps in the host's polling, at
+ * the cost of latency. the 3 and 4 buffer 1024 byte profiles use all of
+ * the endpoint memory, ep6 (bitstream upload) must be disabled for them
+ */
+static const struct
+{
+    BYTE cfg; /* size and buffering bits of EP2CFG */
+    BYTE autoinlenh; /* packet size committed by the fifo */
+    BOOL ep6_free; /* ep6 can be used besides ep2 */
+} __code gpif_profiles[GPIF_PROFILE_COUNT] =
+{
+    {(0<<3) | (0<<1) | (0<<0), 0x02, TRUE}, /* GPIF_PROFILE_512_QUAD */
+    {(1<<3) | (1<<1) | (0<<0), 0x04, TRUE}, /* GPIF_PROFILE_1024_DOUBLE */
+    {(1<<3) | (1<<1) | (1<<0), 0x04, FALSE}, /* GPIF_PROFILE_1024_TRIPLE */
+    {(1<<3) | (0<<1) | (0<<0), 0x04, FALSE}, /* GPIF_PROFILE_1024_QUAD */
+    {(0<<3) | (1<<1) | (0<<0), 0x02, TRUE}, /* GPIF_PROFILE_512_DOUBLE */
+};
+
+static BYTE gpif_profile = GPIF_PROFILE_512_QUAD;
 
 
 void
@@ -114,18 +177,6 @@ gpif_stuff_init()
     SYNCDELAY;
     GPIFIDLECTL = FPGA_READ_DATA;
     SYNCDELAY;
-    GPIFWFSELECT = (1<<6) | (1<<4) | (1<<2) | (0<<0); /* fifo read = 0, others = 1 */
-    SYNCDELAY;
-
-    FLOWSTATE = 0;
-    FLOWLOGIC = 0;
-    FLOWEQ0CTL = 0;
-    FLOWEQ1CTL = 0;
-    FLOWHOLDOFF = 0;
-    FLOWSTB = 0;
-    FLOWSTBEDGE = 0;
-    FLOWSTBHPERIOD = 0;
-    SYNCDELAY;
 
     /* load waveform data */
     AUTOPTRSETUP = 0x07; /* inc both pointers */
@@ -139,34 +190,100 @@ gpif_stuff_init()
     AUTOPTRL1 = LSB(&WaveData_Unused);
     for (i = 0; i < 32; i++)
         EXTAUTODAT2 = EXTAUTODAT1;
-    AUTOPTRH1 = MSB(&WaveData_Unused);
-    AUTOPTRL1 = LSB(&WaveData_Unused);
+    AUTOPTRH1 = MSB(&WaveData_FIFOReadFlow);
+    AUTOPTRL1 = LSB(&WaveData_FIFOReadFlow);
     for (i = 0; i < 32; i++)
         EXTAUTODAT2 = EXTAUTODAT1;
     AUTOPTRH1 = MSB(&WaveData_Unused);
     AUTOPTRL1 = LSB(&WaveData_Unused);
     for (i = 0; i < 32; i++)
         EXTAUTODAT2 = EXTAUTODAT1;
+    gpif_stuff_set_flow(gpif_flow);
     
     /* config ep2 */
-    EP2CFG = (1<<7) | /* enable ep */
-             (1<<6) | /* dir: in */
-             (1<<5) | (0<<4) | /* type: bulk */
-             (0<<3) | /* 1=1024, 0=512 bytes */
-             (0<<1) | (0<<0); /* quad buffered */
-    SYNCDELAY;
+    gpif_stuff_set_profile(gpif_profile);
     //EP2GPIFPFSTOP = (0<<0); /* stop on transaction count */
     EP2GPIFPFSTOP = (1<<0); /* stop on fifo flag */
     EP2GPIFFLGSEL = (1<<1) | (0<<0); /* fifo flag = full flag */
     SYNCDELAY;
     EP2FIFOCFG = bmWORDWIDE | bmAUTOIN;
     SYNCDELAY;
-    EP2AUTOINLENH = 0x02; /* 512 bytes */
+
+    RESETFIFO(2);
+}
+
+
+/*
+ * select the ep2 buffering, aborts a running acquisition and resets the
+ * fifo. if the profile doesn't leave room for ep6 it must be disabled before
+ */
+BOOL
+gpif_stuff_set_profile(BYTE profile)
+{
+    if (profile >= GPIF_PROFILE_COUNT)
+        return FALSE;
+    gpif_profile = profile;
+
+    EP2CFG = (1<<7) | /* enable ep */
+             (1<<6) | /* dir: in */
+             (1<<5) | (0<<4) | /* type: bulk */
+             gpif_profiles[profile].cfg; /* size, buffering */
+    SYNCDELAY;
+    EP2AUTOINLENH = gpif_profiles[profile].autoinlenh;
     SYNCDELAY;
     EP2AUTOINLENL = 0x00;
     SYNCDELAY;
 
-    RESETFIFO(2);
+    gpif_stuff_abort(); /* reset FIFO */
+    return TRUE;
+}
+
+
+/*
+ * select the fifo read waveform: flowstate (one word per clock) or the old
+ * one which takes two clocks per word. must not be called while the gpif
+ * is active. the flowstate values below follow the fx2 trm, neither the rate
+ * nor the exit timing has been measured on hardware, so it is opt-in
+ */
+void
+gpif_stuff_set_flow(BOOL enable)
+{
+    gpif_flow = enable;
+    if (enable)
+    {
+        GPIFWFSELECT = (1<<6) | (1<<4) | (1<<2) | (2<<0); /* fifo read = 2, others = 1 */
+        SYNCDELAY;
+        FLOWSTATE = (1<<7) | 1; /* enable, interval 1 */
+        FLOWLOGIC = (1<<6) | (6<<3) | (0<<0); /* halt on FIFOFull OR RDY0 (fpga not ready) */
+        FLOWEQ0CTL = PROG_B_CTL; /* flowing: READ_N low */
+        FLOWEQ1CTL = PROG_B_CTL | FPGA_READ_DATA; /* halted: READ_N high */
+        FLOWHOLDOFF = 0;
+        FLOWSTB = (0<<7) | 1; /* master strobe on the unused CTL1 */
+        FLOWSTBEDGE = (1<<1) | (1<<0); /* transfer on both edges ... */
+        FLOWSTBHPERIOD = 2; /* ... of a strobe toggling every IFCLK */
+    }
+    else
+    {
+        GPIFWFSELECT = (1<<6) | (1<<4) | (1<<2) | (0<<0); /* fifo read = 0, others = 1 */
+        SYNCDELAY;
+        FLOWSTATE = 0;
+        FLOWLOGIC = 0;
+        FLOWEQ0CTL = 0;
+        FLOWEQ1CTL = 0;
+        FLOWHOLDOFF = 0;
+        FLOWSTB = 0;
+        FLOWSTBEDGE = 0;
+        FLOWSTBHPERIOD = 0;
+    }
+    SYNCDELAY;
+}
+
+
+/* TRUE if ep6 fits besides ep2 with the given profile */
+BOOL
+gpif_stuff_profile_ep6_free(BYTE profile)
+{
+    return profile < GPIF_PROFILE_COUNT && gpif_profiles[profile].ep6_free;
 }
 
 
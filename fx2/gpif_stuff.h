@@ -23,7 +23,18 @@
 
 #include <fx2types.h>
 
+/* ep2 buffering profiles: buffer size and count */
+#define GPIF_PROFILE_512_QUAD     0 /* default */
+#define GPIF_PROFILE_1024_DOUBLE  1
+#define GPIF_PROFILE_1024_TRIPLE  2 /* ep6 disabled */
+#define GPIF_PROFILE_1024_QUAD    3 /* ep6 disabled */
+#define GPIF_PROFILE_512_DOUBLE   4
+#define GPIF_PROFILE_COUNT        5
+
 void gpif_stuff_init();
+BOOL gpif_stuff_set_profile(BYTE profile);
+BOOL gpif_stuff_profile_ep6_free(BYTE profile);
+void gpif_stuff_set_flow(BOOL enable);
 void gpif_stuff_start();
 void gpif_stuff_abort();
 
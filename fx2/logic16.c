@@ -47,15 +47,27 @@
 #define CMD_FPGA_WRITE_REGISTER      0x80
 #define CMD_FPGA_READ_REGISTER       0x81
 #define CMD_GET_REVID                0x82
+#define CMD_FPGA_GET_STATUS          0x83
+#define CMD_SET_EP2_PROFILE          0x84
+#define CMD_SET_GPIF_FLOW            0x85
 
 #define I2C_EEPROM_ADDRESS  0x50
 
+/* CMD_FPGA_UPLOAD_INIT flags */
+#define UPLOAD_FLAG_RLE  (1<<0) /* bitstream on ep6 is rle compressed */
+
 
 static __xdata BYTE led_table[64] = {0};
 static BOOL led_run = FALSE;
 static BOOL led_repeat = FALSE;
 static BYTE led_div = 0;
 
+/* bitstream bytes still expected on ep6 (bulk upload) */
+static DWORD fpga_upload_remaining = 0;
+static BOOL fpga_upload_compressed = FALSE;
+static BOOL fpga_upload_ok = FALSE; /* cleared on failure, the rest is skipped */
+static BOOL ep6_enabled = FALSE;
+
 
 /* logic16 specific ep1 encode/decode functions */
 
@@ -154,6 +166,46 @@ handle_vendorcommand(BYTE command)
 
 /* initialization */
 
+/* drop what is left in ep6 and arm both buffers */
+static void
+ep6_reset()
+{
+    FIFORESET = 0x80;
+    SYNCDELAY;
+    FIFORESET = 6;
+    SYNCDELAY;
+    FIFORESET = 0;
+    SYNCDELAY;
+    OUTPKTEND = 0x86; /* arm both buffers */
+    SYNCDELAY;
+    OUTPKTEND = 0x86;
+    SYNCDELAY;
+}
+
+/* ep6 out for bitstream upload, cpu handles the packets. disabled with
+ * the ep2 profiles which need all endpoint memory */
+static void
+ep6_init(BOOL enable)
+{
+    fpga_upload_remaining = 0;
+    ep6_enabled = enable;
+    if (!enable)
+    {
+        EP6CFG = 0;
+        SYNCDELAY;
+        return;
+    }
+
+    EP6CFG = (1<<7) | /* valid */
+             (0<<6) | /* dir: out */
+             (1<<5) | (0<<4) | /* bulk */
+             (0<<3) | /* 512 bytes */
+             (1<<1) | (0<<0); /* double buffered */
+    SYNCDELAY;
+    ep6_reset();
+}
+
+
 static void
 ep_init()
 {
@@ -171,13 +223,13 @@ ep_init()
     OUTPKTEND = 0x81;
     SYNCDELAY;
 
+    ep6_init(TRUE);
+
     /* disable other endpoints */
     EP2CFG = 0;
     SYNCDELAY;
     EP4CFG = 0;
     SYNCDELAY;
-    EP6CFG = 0;
-    SYNCDELAY;
     EP8CFG = 0;
     SYNCDELAY;
     
@@ -287,36 +339,109 @@ main_loop()
             break;
             
         case CMD_FPGA_UPLOAD_INIT:
+            fpga_upload_remaining = 0;
+            if ((len_out == 5 || len_out == 6) && !ep6_enabled)
+                break; /* ep2 profile uses the memory of ep6 */
             ok = fpga_upload_init();
+            if (ok && (len_out == 5 || len_out == 6))
+            {
+                /* total length given: bitstream follows on ep6, a one
+                 * byte reply (1 = ok) is sent when it was uploaded.
+                 * the optional flags byte selects the compressed format */
+                fpga_upload_remaining = ((DWORD)buf_out[4] << 24) | ((DWORD)buf_out[3] << 16) |
+                                        ((WORD)buf_out[2] << 8) | buf_out[1];
+                fpga_upload_compressed = len_out == 6 && (buf_out[5] & UPLOAD_FLAG_RLE);
+                fpga_upload_ok = TRUE;
+                /* packets left over from a failed upload must not be
+                 * taken as the start of this one */
+                ep6_reset();
+            }
             break;
         case CMD_FPGA_UPLOAD_DATA:
             if (len_out > 2 && (buf_out[1] + 2) == len_out)
             {
-                ok = fpga_upload_data(buf_out + 2, buf_out[1]);
+                /* FIXME: find better way of detecting end of data */
+                ok = fpga_upload_data(buf_out + 2, buf_out[1], buf_out[1] < 62);
             }
             break;
         case CMD_FPGA_WRITE_REGISTER:
             if (len_out > 2 && (2*buf_out[1] + 2) == len_out)
             {
-                BYTE i;
-                for (i = 0; i < buf_out[1]; i++)
-                    fpga_write_reg(buf_out[2 + 2*i], buf_out[2 + 2*i + 1]);
+                BYTE i = 0, n;
+                while (i < buf_out[1])
+                {
+                    /* move values of consecutive addresses together and
+                     * write them in one burst */
+                    BYTE *vals = buf_out + 2 + 2*i + 1;
+                    for (n = 1; i + n < buf_out[1] &&
+                                buf_out[2 + 2*(i + n)] == buf_out[2 + 2*i] + n; n++)
+                        vals[n] = vals[2*n];
+                    fpga_write_regs(buf_out[2 + 2*i], vals, n);
+                    i += n;
+                }
                 ok = TRUE;
             }
             break;
         case CMD_FPGA_READ_REGISTER:
             if (len_out > 2 && (buf_out[1] + 2) == len_out)
             {
-                BYTE i;
+                BYTE i = 0, n;
                 /* wait for ep1in ready */
                 while (EP1INCS & bmEPBUSY);
-                for (i = 0; i < buf_out[1]; i++)
-                    buf_in[i] = fpga_read_reg(buf_out[2 + i]);
+                while (i < buf_out[1])
+                {
+                    /* read consecutive addresses in one burst */
+                    for (n = 1; i + n < buf_out[1] &&
+                                buf_out[2 + i + n] == buf_out[2 + i] + n; n++);
+                    fpga_read_regs(buf_out[2 + i], buf_in + i, n);
+                    i += n;
+                }
                 len_in = buf_out[1];
                 ok = TRUE;
             }
             break;
 
+        case CMD_SET_EP2_PROFILE:
+            if (len_out == 2 && buf_out[1] < GPIF_PROFILE_COUNT)
+            {
+                /* see GPIF_PROFILE_*, before starting an acquisition */
+                BOOL ep6_free = gpif_stuff_profile_ep6_free(buf_out[1]);
+                if (!ep6_free)
+                    ep6_init(FALSE);
+                ok = gpif_stuff_set_profile(buf_out[1]);
+                if (ep6_free && !ep6_enabled)
+                    ep6_init(TRUE);
+            }
+            break;
+        case CMD_SET_GPIF_FLOW:
+            if (len_out == 2)
+            {
+                /* 1: flowstate waveform, 0: the old one (default), before
+                 * starting an acquisition */
+                gpif_stuff_abort();
+                gpif_stuff_set_flow(buf_out[1] != 0);
+                ok = TRUE;
+            }
+            break;
+        case CMD_FPGA_GET_STATUS:
+            if (len_out == 1)
+            {
+                /* reply: done, fpga version, bitstream id (4 bytes), so
+                 * the host can skip the upload if the right bitstream is
+                 * loaded already. zeros when the fpga isn't configured */
+                /* wait for ep1in ready */
+                while (EP1INCS & bmEPBUSY);
+                buf_in[0] = buf_in[1] = buf_in[2] = buf_in[3] = buf_in[4] = buf_in[5] = 0;
+                if (fpga_is_configured())
+                {
+                    buf_in[0] = 1;
+                    fpga_read_regs(FPGA_ADDRESS_VERSION, buf_in + 1, 1);
+                    fpga_read_regs(FPGA_ADDRESS_BITSTREAM_ID, buf_in + 2, 4);
+                }
+                len_in = 6;
+                ok = TRUE;
+            }
+            break;
 
         case CMD_START_ACQUISITION:
             if (len_out == 1)
@@ -367,6 +492,43 @@ main_loop()
         SYNCDELAY;
     }
     
+    /* bitstream upload on ep6 */
+    if (fpga_upload_remaining > 0 && !(EP2468STAT & bmEP6EMPTY))
+    {
+        BYTE *data = EP6FIFOBUF;
+        WORD len = MAKEWORD(EP6BCH, EP6BCL);
+        if (len > fpga_upload_remaining)
+            len = fpga_upload_remaining;
+        if (fpga_upload_ok && fpga_upload_compressed)
+        {
+            fpga_upload_remaining -= len;
+            fpga_upload_ok = fpga_upload_rle(data, len, fpga_upload_remaining == 0);
+            len = 0;
+        }
+        while (fpga_upload_ok && len > 0)
+        {
+            BYTE n = len > 255 ? 255 : len;
+            fpga_upload_remaining -= n;
+            fpga_upload_ok = fpga_upload_data(data, n, fpga_upload_remaining == 0);
+            data += n;
+            len -= n;
+        }
+        /* after a failure the packets are skipped until the announced
+         * length is consumed, so the host's bulk out doesn't stall */
+        fpga_upload_remaining -= len;
+        OUTPKTEND = 0x86; /* give buffer back */
+        SYNCDELAY;
+        if (fpga_upload_remaining == 0)
+        {
+            /* send result */
+            while (EP1INCS & bmEPBUSY);
+            EP1INBUF[0] = fpga_upload_ok;
+            ep1_encrypt(EP1INBUF, EP1INBUF, 1);
+            SYNCDELAY;
+            EP1INBC = 1;
+        }
+    }
+
     /* led stuff */
     if (TF2)
     {
@@ -0,0 +1,95 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+----------------------------------------------------------------------------------
+--
+-- per channel minimum pulse width filter (deglitcher)
+--
+-- the output of a channel only takes a new level after the input had it for
+-- width clocks in a row, shorter pulses are removed. both edges are delayed by
+-- width clocks so the pulses which pass keep their width. width 0 and 1 pass
+-- the input through. the counters count down to a registered zero flag, so
+-- there is only one lut between the flip flops of the output
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity glitch_filter is
+    port(
+        clk      : in std_logic;
+        width    : in std_logic_vector(63 downto 0); -- minimum pulse width in clocks, 4 bits per channel (channel 0 in 3 downto 0), async (must only be changed while the output is not used)
+        data_in  : in std_logic_vector(15 downto 0);
+        data_out : out std_logic_vector(15 downto 0) := (others=>'0')
+    );
+end glitch_filter;
+
+
+architecture behavioral of glitch_filter is
+
+    type count_arr_t is array (0 to 15) of unsigned(3 downto 0);
+
+    signal width_m1 : count_arr_t; -- counter start value, width - 1
+    signal pass     : std_logic_vector(15 downto 0); -- width is 0 or 1
+    signal count    : count_arr_t := (others=>(others=>'0')); -- clocks left until the input is taken
+    signal zero     : std_logic_vector(15 downto 0) := (others=>'1'); -- count is 0
+    signal data     : std_logic_vector(15 downto 0) := (others=>'0');
+
+    attribute TIG : string;
+    attribute TIG of width : signal is "TRUE";
+
+begin
+
+    gen : for i in 0 to 15 generate
+    begin
+        width_m1(i) <= unsigned(width(4*i+3 downto 4*i)) - 1;
+        pass(i) <= '1' when (unsigned(width(4*i+3 downto 4*i)) <= 1) else '0';
+    end generate gen;
+
+    data_out <= data;
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            for i in 0 to 15 loop
+                if (data_in(i) = data(i)) then
+                    -- no change, start over
+                    count(i) <= width_m1(i);
+                    zero(i) <= pass(i);
+                elsif (zero(i) = '1') then
+                    -- the input was stable for width clocks
+                    data(i) <= data_in(i);
+                    count(i) <= width_m1(i);
+                    zero(i) <= pass(i);
+                else
+                    count(i) <= count(i) - 1;
+                    if (count(i) = 1) then
+                        zero(i) <= '1';
+                    else
+                        zero(i) <= '0';
+                    end if;
+                end if;
+            end loop;
+        end if;
+    end process;
+
+end behavioral;
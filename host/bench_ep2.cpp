@@ -0,0 +1,281 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * ep2 throughput benchmark
+ *
+ * for each ep2 buffering profile the fpga streams its test pattern (a 16 bit
+ * counter, one word per sample) at a sweep of sample rates. the counter is
+ * checked for gaps and the fpga telemetry is read after each run, so a run
+ * fails if a single word was lost anywhere. the result per profile is the
+ * sustained MB/s of each rate and the dropout threshold, the highest rate
+ * which ran without loss
+ *
+ * usage: bench_ep2 [options]
+ *   -p 0,1,..    profiles to test (default: all)
+ *   -d 19,9,..   sample rate divisors to sweep (default: 19,9,7,6,5,4,3)
+ *   -t seconds   duration of each run (default: 3)
+ *   -q count     usb transfers queued (default: 16)
+ *   -s bytes     size of each transfer (default: 65536)
+ *   -b file      upload this bitstream first (.rle: compressed)
+ *   -g 0|1       gpif waveform, 1: flowstate, 0: the old one (default)
+ */
+
+#include "logic16.hpp"
+
+#include <libusb.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace logic16;
+
+namespace
+{
+
+struct options
+{
+    std::vector<int> profiles{0, 1, 2, 3, 4};
+    std::vector<uint32_t> divisors{19, 9, 7, 6, 5, 4, 3};
+    double seconds = 3;
+    int queue = 16;
+    int transfer_size = 65536;
+    std::string bitstream;
+    bool flow = false;
+};
+
+/* counter check of the test pattern, shared by the transfer callbacks */
+struct stream
+{
+    bool running = false;
+    bool failed = false; // usb error
+    int pending = 0; // transfers submitted
+    uint64_t bytes = 0;
+    uint64_t gaps = 0; // words missing in the counter
+    uint16_t expected = 0;
+    bool odd = false; // a word was split between two transfers
+    uint8_t low = 0;
+};
+
+void
+check_words(stream &s, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!s.odd)
+        {
+            s.low = data[i];
+            s.odd = true;
+            continue;
+        }
+        s.odd = false;
+        uint16_t w = s.low | (data[i] << 8);
+        s.gaps += (uint16_t)(w - s.expected);
+        s.expected = w + 1;
+    }
+}
+
+void LIBUSB_CALL
+transfer_done(libusb_transfer *t)
+{
+    stream &s = *static_cast<stream *>(t->user_data);
+    if (t->status == LIBUSB_TRANSFER_COMPLETED || t->status == LIBUSB_TRANSFER_TIMED_OUT)
+    {
+        s.bytes += t->actual_length;
+        check_words(s, t->buffer, t->actual_length);
+    }
+    else if (t->status != LIBUSB_TRANSFER_CANCELLED)
+    {
+        s.failed = true;
+    }
+    if (s.running && !s.failed && libusb_submit_transfer(t) == 0)
+        return;
+    s.pending--;
+}
+
+struct result
+{
+    double rate; // samples/s
+    double mbytes; // MB/s received
+    uint64_t lost; // words lost
+};
+
+result
+run(device &dev, const options &opt, uint32_t div)
+{
+    std::vector<std::vector<uint8_t>> buffers(opt.queue, std::vector<uint8_t>(opt.transfer_size));
+    std::vector<libusb_transfer *> transfers;
+    stream s;
+
+    dev.write_regs({{ADDRESS_CHANNEL_SELECT_LO, 0xff},
+                    {ADDRESS_CHANNEL_SELECT_HI, 0xff},
+                    {ADDRESS_SAMPLE_CLOCK_CONTROL, 0},
+                    {ADDRESS_SAMPLE_MODE, ENCODING_TEST_PATTERN}});
+    dev.set_sample_rate_divisor(div);
+
+    s.running = true;
+    for (auto &b : buffers)
+    {
+        libusb_transfer *t = libusb_alloc_transfer(0);
+        libusb_fill_bulk_transfer(t, dev.handle(), EP_DATA_IN, b.data(), b.size(), transfer_done, &s, 1000);
+        transfers.push_back(t);
+        if (libusb_submit_transfer(t) == 0)
+            s.pending++;
+    }
+
+    dev.start();
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration<double>(opt.seconds);
+    uint64_t start_bytes = 0;
+    bool started = false;
+    while (std::chrono::steady_clock::now() < end && !s.failed)
+    {
+        timeval tv{0, 100000};
+        libusb_handle_events_timeout(dev.context(), &tv);
+        if (!started && s.bytes > 0)
+        {
+            /* measure from the first data on */
+            started = true;
+            start = std::chrono::steady_clock::now();
+            end = start + std::chrono::duration<double>(opt.seconds);
+            start_bytes = s.bytes;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t bytes = s.bytes - start_bytes;
+    struct telemetry tel = dev.telemetry();
+    dev.stop();
+
+    s.running = false;
+    for (auto t : transfers)
+        libusb_cancel_transfer(t);
+    while (s.pending > 0)
+        libusb_handle_events(dev.context());
+    for (auto t : transfers)
+        libusb_free_transfer(t);
+    if (s.failed)
+        throw std::runtime_error("usb transfer failed");
+
+    result r;
+    r.rate = SAMPLE_CLOCK / (div + 1);
+    r.mbytes = bytes / elapsed / 1e6;
+    /* the fifo counts what it dropped, the counter shows what was lost
+     * after the fifo. gaps > 65535 words wrap, so take the larger one */
+    r.lost = tel.dropped > s.gaps ? tel.dropped : s.gaps;
+    return r;
+}
+
+template <typename T>
+std::vector<T>
+parse_list(const char *arg)
+{
+    std::vector<T> v;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        v.push_back((T)std::strtoul(item.c_str(), nullptr, 0));
+    return v;
+}
+
+void
+usage(const char *name)
+{
+    std::fprintf(stderr, "usage: %s [-p profiles] [-d divisors] [-t seconds] [-q count] [-s bytes] [-b bitstream] [-g 0|1]\n",
+                 name);
+    std::exit(2);
+}
+
+} // namespace
+
+
+int
+main(int argc, char **argv)
+{
+    options opt;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc || argv[i][0] != '-' || std::strlen(argv[i]) != 2)
+            usage(argv[0]);
+        const char *arg = argv[++i];
+        switch (argv[i - 1][1])
+        {
+        case 'p': opt.profiles = parse_list<int>(arg); break;
+        case 'd': opt.divisors = parse_list<uint32_t>(arg); break;
+        case 't': opt.seconds = std::atof(arg); break;
+        case 'q': opt.queue = std::atoi(arg); break;
+        case 's': opt.transfer_size = std::atoi(arg); break;
+        case 'b': opt.bitstream = arg; break;
+        case 'g': opt.flow = std::atoi(arg) != 0; break;
+        default: usage(argv[0]);
+        }
+    }
+
+    try
+    {
+        device dev;
+
+        if (!opt.bitstream.empty())
+        {
+            bool rle = opt.bitstream.size() > 4 &&
+                       opt.bitstream.compare(opt.bitstream.size() - 4, 4, ".rle") == 0;
+            dev.set_ep2_profile(PROFILE_512_QUAD); // ep6 is needed for the upload
+            dev.upload_bitstream(read_file(opt.bitstream), rle);
+        }
+        struct status st = dev.status();
+        if (!st.done)
+            throw std::runtime_error("fpga not configured, use -b");
+        std::printf("fpga version %d, bitstream id %08x\n", st.version, (unsigned)st.bitstream_id);
+        dev.set_gpif_flow(opt.flow);
+        std::printf("%s gpif waveform, %d transfers of %d bytes, %.1fs per run\n\n",
+                    opt.flow ? "flowstate" : "handshake", opt.queue, opt.transfer_size, opt.seconds);
+        std::printf("%-8s %10s %10s %10s %12s\n", "profile", "MS/s", "MB/s", "MB/s got", "words lost");
+
+        for (int p : opt.profiles)
+        {
+            double threshold = 0;
+            dev.set_ep2_profile(p);
+            for (uint32_t div : opt.divisors)
+            {
+                result r = run(dev, opt, div);
+                std::printf("%-8s %10.3f %10.3f %10.3f %12llu\n", profile_name(p), r.rate / 1e6,
+                            2 * r.rate / 1e6, r.mbytes, (unsigned long long)r.lost);
+                if (r.lost == 0 && r.rate > threshold)
+                    threshold = r.rate;
+            }
+            std::printf("%-8s dropout threshold: %.3f MS/s (%.3f MB/s)\n\n", profile_name(p),
+                        threshold / 1e6, 2 * threshold / 1e6);
+        }
+        dev.set_ep2_profile(PROFILE_512_QUAD);
+        dev.set_gpif_flow(false);
+    }
+    catch (std::exception &e)
+    {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * block decoder benchmark
+ *
+ * decodes a buffer of random data in usb transfer sized pieces with each
+ * kernel and channel mask and prints the GB/s of stream data and the
+ * samples/s, which must be above 100MS/s to keep up with a burst (16
+ * channels at 100MHz are 0.2 GB/s)
+ *
+ * usage: bench_transpose [options]
+ *   -m ffff,00ff,..  channel masks (default: ffff,00ff,0001,a5a5)
+ *   -t seconds       duration of each run (default: 1)
+ *   -s bytes         size of each piece (default: 65536)
+ */
+
+#include "transpose.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace logic16;
+
+namespace
+{
+
+const double BURST_RATE = 100e6; // samples/s
+
+void
+usage(const char *name)
+{
+    std::fprintf(stderr, "usage: %s [-m masks] [-t seconds] [-s bytes]\n", name);
+    std::exit(2);
+}
+
+} // namespace
+
+
+int
+main(int argc, char **argv)
+{
+    std::vector<uint16_t> masks{0xffff, 0x00ff, 0x0001, 0xa5a5};
+    double seconds = 1;
+    size_t piece = 65536;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc || argv[i][0] != '-' || std::strlen(argv[i]) != 2)
+            usage(argv[0]);
+        const char *arg = argv[++i];
+        switch (argv[i - 1][1])
+        {
+        case 'm':
+        {
+            masks.clear();
+            std::stringstream ss(arg);
+            std::string item;
+            while (std::getline(ss, item, ','))
+                masks.push_back(std::strtoul(item.c_str(), nullptr, 16));
+            break;
+        }
+        case 't': seconds = std::atof(arg); break;
+        case 's': piece = std::strtoul(arg, nullptr, 0); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (piece == 0)
+        usage(argv[0]);
+
+    /* 16MB, larger than the caches like a real stream */
+    std::vector<uint8_t> data(16 << 20);
+    std::mt19937 rng(1);
+    for (auto &d : data)
+        d = rng();
+
+    std::printf("%-8s %6s %10s %12s %10s\n", "kernel", "mask", "GB/s", "MS/s", "x 100MHz");
+    for (int k = 0; k < KERNEL_COUNT; k++)
+    {
+        if (!kernel_supported(k))
+            continue;
+        for (uint16_t mask : masks)
+        {
+            if (mask == 0)
+                continue;
+            block_decoder dec(mask, k);
+            std::vector<uint16_t> samples(dec.max_samples(piece));
+            uint64_t bytes = 0, count = 0;
+            auto start = std::chrono::steady_clock::now();
+            auto end = start + std::chrono::duration<double>(seconds);
+            size_t pos = 0;
+            do
+            {
+                for (int i = 0; i < 16; i++)
+                {
+                    size_t len = data.size() - pos < piece ? data.size() - pos : piece;
+                    count += dec.decode(data.data() + pos, len, samples.data());
+                    bytes += len;
+                    pos = (pos + len) % data.size();
+                }
+            } while (std::chrono::steady_clock::now() < end);
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::printf("%-8s %6.4x %10.3f %12.1f %10.1f\n", kernel_name(k), mask, bytes / elapsed / 1e9,
+                        count / elapsed / 1e6, count / elapsed / BURST_RATE);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#include "emulator.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace logic16
+{
+
+emulator::emulator(uint16_t channel_mask, double sample_rate)
+{
+    unsigned channels = 0;
+    for (unsigned c = 0; c < 16; c++)
+        channels += (channel_mask >> c) & 1;
+    if (channels == 0)
+        throw std::runtime_error("no channel selected");
+    rate = sample_rate * channels / 8;
+
+    /* one word per block and channel, the msb is the first sample */
+    for (unsigned s = 0; s < 65536; s += 16)
+    {
+        for (unsigned c = 0; c < 16; c++)
+        {
+            if (!(channel_mask & (1 << c)))
+                continue;
+            uint16_t w = 0;
+            for (unsigned i = 0; i < 16; i++)
+                w |= (((s + i) >> c) & 1) << (15 - i);
+            period.push_back(w & 0xff);
+            period.push_back(w >> 8);
+        }
+    }
+}
+
+
+void
+emulator::fill(uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        size_t n = period.size() - pos;
+        if (n > len)
+            n = len;
+        std::memcpy(buf, period.data() + pos, n);
+        buf += n;
+        len -= n;
+        pos = (pos + n) % period.size();
+    }
+}
+
+
+void
+emulator::skip(size_t len)
+{
+    pos = (pos + len) % period.size();
+}
+
+
+void
+emulator::run(recorder &rec, double seconds)
+{
+    typedef std::chrono::steady_clock clock;
+    const size_t len = rec.buffer_size();
+    const auto start = clock::now();
+    const auto end = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+    uint64_t produced = 0;
+
+    for (;;)
+    {
+        if (rate > 0)
+        {
+            /* the transfer completes when the device has sent its last byte */
+            auto due = start + std::chrono::duration_cast<clock::duration>(
+                                   std::chrono::duration<double>((produced + len) / rate));
+            if (due > end)
+                break;
+            std::this_thread::sleep_until(due);
+        }
+        else if (clock::now() >= end)
+        {
+            break;
+        }
+
+        uint8_t *buf = rec.acquire();
+        if (buf != nullptr)
+        {
+            fill(buf, len);
+            rec.commit(buf, len);
+        }
+        else
+        {
+            skip(len);
+            rec.drop(len);
+        }
+        produced += len;
+    }
+}
+
+} // namespace logic16
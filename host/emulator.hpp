@@ -0,0 +1,72 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+/*
+ * software logic16 for benchmarking the recorder without hardware
+ *
+ * the inputs are a 16 bit counter (sample n has the value n), encoded in
+ * the channel major stream of ENCODING_BLOCKS like sample.vhd does it (see
+ * transpose.hpp). run() produces it at the byte rate of the sample rate and
+ * channel mask and hands it to a recorder one transfer at a time, like the
+ * usb callbacks of record.cpp: a transfer without a free buffer is dropped
+ */
+
+#ifndef EMULATOR_HPP
+#define EMULATOR_HPP
+
+#include "recorder.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace logic16
+{
+
+class emulator
+{
+public:
+    /* sample_rate 0: as fast as possible. throws std::runtime_error if no
+     * channel is selected */
+    emulator(uint16_t channel_mask, double sample_rate);
+
+    /* bytes per block of 16 samples */
+    size_t block_size() const { return period.size() / (65536 / 16); }
+    /* bytes/s of the stream, 0: unlimited */
+    double byte_rate() const { return rate; }
+
+    /* the next len bytes of the stream */
+    void fill(uint8_t *buf, size_t len);
+    /* lose the next len bytes */
+    void skip(size_t len);
+
+    /* produce transfers of rec.buffer_size() bytes for seconds */
+    void run(recorder &rec, double seconds);
+
+private:
+    std::vector<uint8_t> period; // the stream repeats after 65536 samples
+    size_t pos = 0;
+    double rate;
+};
+
+} // namespace logic16
+
+#endif /* EMULATOR_HPP */
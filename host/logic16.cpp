@@ -0,0 +1,359 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "logic16.hpp"
+
+#include <libusb.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace logic16
+{
+
+namespace
+{
+
+const uint16_t VID = 0x21a9;
+const uint16_t PID = 0x1001;
+const unsigned EP_CMD_OUT = 0x01;
+const unsigned EP_CMD_IN = 0x81;
+const unsigned EP_UPLOAD_OUT = 0x06;
+const unsigned TIMEOUT = 1000; // ms
+const unsigned UPLOAD_TIMEOUT = 5000; // ms, for the result of the upload
+
+/* ep1 encode/decode, same as in fx2/logic16.c */
+void
+encrypt(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    uint8_t st0 = 0x9b, st1 = 0x54;
+    while (count-- > 0)
+    {
+        uint8_t s = *src++, x;
+        x = (((s ^ st1 ^ 0x2b) - 0x05) ^ 0x35) - 0x39;
+        x = (((x ^ st0 ^ 0x5a) - 0xb0) ^ 0x38) - 0x45;
+        *dst++ = x;
+        st0 = s;
+        st1 = x;
+    }
+}
+
+void
+decrypt(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    uint8_t st0 = 0x9b, st1 = 0x54;
+    while (count-- > 0)
+    {
+        uint8_t s = *src++, x;
+        x = (((s + 0x45) ^ 0x38) + 0xb0) ^ 0x5a ^ st0;
+        x = (((x + 0x39) ^ 0x35) + 0x05) ^ 0x2b ^ st1;
+        *dst++ = x;
+        st0 = x;
+        st1 = s;
+    }
+}
+
+void
+check(int ret, const char *what)
+{
+    if (ret < 0)
+        throw std::runtime_error(std::string(what) + ": " + libusb_error_name(ret));
+}
+
+uint32_t
+le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+} // namespace
+
+
+const char *
+profile_name(int profile)
+{
+    static const char *names[PROFILE_COUNT] =
+    {
+        "512x4", "1024x2", "1024x3", "1024x4", "512x2"
+    };
+    if (profile < 0 || profile >= PROFILE_COUNT)
+        return "?";
+    return names[profile];
+}
+
+
+device::device()
+{
+    check(libusb_init(&ctx), "libusb_init");
+    dev = libusb_open_device_with_vid_pid(ctx, VID, PID);
+    if (dev == nullptr)
+    {
+        libusb_exit(ctx);
+        throw std::runtime_error("no logic16 found");
+    }
+    int ret = libusb_claim_interface(dev, 0);
+    if (ret < 0)
+    {
+        libusb_close(dev);
+        libusb_exit(ctx);
+        check(ret, "libusb_claim_interface");
+    }
+}
+
+
+device::~device()
+{
+    libusb_release_interface(dev, 0);
+    libusb_close(dev);
+    libusb_exit(ctx);
+}
+
+
+void
+device::command(const std::vector<uint8_t> &cmd, uint8_t *reply, size_t reply_len)
+{
+    std::vector<uint8_t> buf(cmd.size());
+    int n;
+
+    encrypt(buf.data(), cmd.data(), cmd.size());
+    check(libusb_bulk_transfer(dev, EP_CMD_OUT, buf.data(), buf.size(), &n, TIMEOUT), "command");
+    if (reply_len == 0)
+        return;
+
+    buf.resize(64);
+    check(libusb_bulk_transfer(dev, EP_CMD_IN, buf.data(), buf.size(), &n, TIMEOUT), "reply");
+    if ((size_t)n != reply_len)
+        throw std::runtime_error("short reply");
+    decrypt(reply, buf.data(), reply_len);
+}
+
+
+void
+device::write_regs(const std::vector<std::pair<uint8_t, uint8_t>> &regs)
+{
+    std::vector<uint8_t> cmd{CMD_FPGA_WRITE_REGISTER, (uint8_t)regs.size()};
+    for (auto &r : regs)
+    {
+        cmd.push_back(r.first);
+        cmd.push_back(r.second);
+    }
+    command(cmd);
+}
+
+
+void
+device::read_regs(uint8_t addr, uint8_t *vals, size_t count)
+{
+    std::vector<uint8_t> cmd{CMD_FPGA_READ_REGISTER, (uint8_t)count};
+    for (size_t i = 0; i < count; i++)
+        cmd.push_back(addr + i);
+    command(cmd, vals, count);
+}
+
+
+uint8_t
+device::read_reg(uint8_t addr)
+{
+    uint8_t val;
+    read_regs(addr, &val, 1);
+    return val;
+}
+
+
+struct status
+device::status()
+{
+    uint8_t r[6];
+    command({CMD_FPGA_GET_STATUS}, r, sizeof(r));
+    return {r[0] != 0, r[1], le32(r + 2)};
+}
+
+
+void
+device::upload_bitstream(const std::vector<uint8_t> &data, bool rle)
+{
+    const size_t size = data.size();
+    uint8_t result = 0;
+    int n;
+
+    command({CMD_FPGA_UPLOAD_INIT, (uint8_t)size, (uint8_t)(size >> 8), (uint8_t)(size >> 16),
+             (uint8_t)(size >> 24), (uint8_t)(rle ? 1 : 0)});
+    check(libusb_bulk_transfer(dev, EP_UPLOAD_OUT, const_cast<uint8_t *>(data.data()), size, &n,
+                               UPLOAD_TIMEOUT), "upload");
+
+    uint8_t buf[64];
+    check(libusb_bulk_transfer(dev, EP_CMD_IN, buf, sizeof(buf), &n, UPLOAD_TIMEOUT), "upload result");
+    if (n == 1)
+        decrypt(&result, buf, 1);
+    if (result != 1)
+        throw std::runtime_error("fpga configuration failed");
+}
+
+
+void
+device::set_ep2_profile(int profile)
+{
+    command({CMD_SET_EP2_PROFILE, (uint8_t)profile});
+}
+
+
+void
+device::set_gpif_flow(bool flow)
+{
+    command({CMD_SET_GPIF_FLOW, (uint8_t)(flow ? 1 : 0)});
+}
+
+
+void
+device::set_sample_rate_divisor(uint32_t div)
+{
+    /* the low byte commits mid and hi */
+    write_regs({{ADDRESS_SAMPLE_RATE_DIVISOR_MID, (uint8_t)(div >> 8)},
+                {ADDRESS_SAMPLE_RATE_DIVISOR_HI, (uint8_t)(div >> 16)},
+                {ADDRESS_SAMPLE_RATE_DIVISOR, (uint8_t)div}});
+}
+
+
+void
+device::set_glitch_width(const uint8_t width[16])
+{
+    std::vector<std::pair<uint8_t, uint8_t>> regs;
+    for (int i = 0; i < 8; i++)
+        regs.push_back({ADDRESS_GLITCH_WIDTH + i, (width[2*i] & 15) | (width[2*i + 1] << 4)});
+    write_regs(regs);
+}
+
+
+void
+device::set_peak_window(uint16_t samples)
+{
+    write_regs({{ADDRESS_PEAK_WINDOW, (uint8_t)samples},
+                {ADDRESS_PEAK_WINDOW + 1, (uint8_t)(samples >> 8)}});
+}
+
+
+struct telemetry
+device::telemetry()
+{
+    uint8_t r[ADDRESS_TELEMETRY_SAMPLES + 4 - ADDRESS_TELEMETRY_CONTROL];
+    write_reg(ADDRESS_TELEMETRY_CONTROL, 0); // snapshot
+    read_regs(ADDRESS_TELEMETRY_CONTROL, r, sizeof(r));
+    struct telemetry t;
+    t.flags = r[0];
+    t.dropped = le32(r + ADDRESS_TELEMETRY_DROPPED - ADDRESS_TELEMETRY_CONTROL);
+    t.high_water = r[ADDRESS_TELEMETRY_HIGH_WATER - ADDRESS_TELEMETRY_CONTROL] |
+                   (r[ADDRESS_TELEMETRY_HIGH_WATER + 1 - ADDRESS_TELEMETRY_CONTROL] << 8);
+    t.words = le32(r + ADDRESS_TELEMETRY_WORDS - ADDRESS_TELEMETRY_CONTROL);
+    t.samples = le32(r + ADDRESS_TELEMETRY_SAMPLES - ADDRESS_TELEMETRY_CONTROL);
+    return t;
+}
+
+
+void
+device::set_stats_gate(uint32_t samples)
+{
+    write_regs({{ADDRESS_STATS_GATE, (uint8_t)samples},
+                {ADDRESS_STATS_GATE + 1, (uint8_t)(samples >> 8)},
+                {ADDRESS_STATS_GATE + 2, (uint8_t)(samples >> 16)},
+                {ADDRESS_STATS_GATE + 3, (uint8_t)(samples >> 24)}});
+}
+
+
+struct statistics
+device::statistics()
+{
+    /* hold the results and rewind the data register, it returns the next
+     * byte on each read, so it is listed once per byte (not a burst) */
+    const size_t max_count = 62; // fills the 64 byte ep1 packet
+    uint8_t r[4 + 16*8];
+    write_reg(ADDRESS_STATS_CONTROL, 1);
+    uint8_t control = read_reg(ADDRESS_STATS_CONTROL);
+    for (size_t i = 0, n; i < sizeof(r); i += n)
+    {
+        n = std::min(sizeof(r) - i, max_count);
+        std::vector<uint8_t> cmd(2 + n, ADDRESS_STATS_DATA);
+        cmd[0] = CMD_FPGA_READ_REGISTER;
+        cmd[1] = n;
+        command(cmd, r + i, n);
+    }
+    write_reg(ADDRESS_STATS_CONTROL, 0);
+    struct statistics s;
+    s.valid = (control & 0x80) != 0;
+    s.gate = le32(r);
+    s.saturated = 0;
+    for (int c = 0; c < 16; c++)
+    {
+        /* 24 bit counts, the top byte flags a saturated counter */
+        const uint8_t *e = r + 4 + 8*c;
+        const uint8_t *h = r + 8 + 8*c;
+        s.edges[c] = le32(e) & 0xffffff;
+        s.high[c] = le32(h) & 0xffffff;
+        if ((e[3] | h[3]) & 1)
+            s.saturated |= 1 << c;
+    }
+    return s;
+}
+
+
+void
+device::start()
+{
+    command({CMD_START_ACQUISITION});
+    write_reg(ADDRESS_STATUS_CONTROL, 0x41); // run
+}
+
+
+void
+device::flush()
+{
+    write_reg(ADDRESS_SAMPLE_MODE, read_reg(ADDRESS_SAMPLE_MODE) | SAMPLE_MODE_FLUSH);
+}
+
+
+void
+device::stop(bool sync)
+{
+    write_reg(ADDRESS_STATUS_CONTROL, 0x00);
+    if (!sync)
+    {
+        command({CMD_ABORT_ACQUISITION_ASYNC});
+        return;
+    }
+    /* the fx2 replies with the inverted cookie */
+    const uint8_t cookie = 0xa5;
+    uint8_t reply;
+    command({CMD_ABORT_ACQUISITION_SYNC, cookie}, &reply, 1);
+    if (reply != (uint8_t)~cookie)
+        throw std::runtime_error("bad abort reply");
+}
+
+
+std::vector<uint8_t>
+read_file(const std::string &name)
+{
+    std::ifstream f(name, std::ios::binary);
+    if (!f)
+        throw std::runtime_error("can't open " + name);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+} // namespace logic16
@@ -0,0 +1,197 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * minimal access to a logic16 running the la16fw firmware, for the host
+ * tools in this directory (the real driver is the one in libsigrok)
+ */
+
+#ifndef LOGIC16_HPP
+#define LOGIC16_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct libusb_context;
+struct libusb_device_handle;
+
+namespace logic16
+{
+
+/* ep1 commands, see fx2/logic16.c */
+enum command
+{
+    CMD_START_ACQUISITION       = 0x01,
+    CMD_ABORT_ACQUISITION_ASYNC = 0x02,
+    CMD_ABORT_ACQUISITION_SYNC  = 0x7d,
+    CMD_FPGA_UPLOAD_INIT        = 0x7e,
+    CMD_FPGA_WRITE_REGISTER     = 0x80,
+    CMD_FPGA_READ_REGISTER      = 0x81,
+    CMD_FPGA_GET_STATUS         = 0x83,
+    CMD_SET_EP2_PROFILE         = 0x84,
+    CMD_SET_GPIF_FLOW           = 0x85,
+};
+
+/* fpga registers, see the generics of mainmodule.vhd */
+enum address
+{
+    ADDRESS_FPGA_VERSION        = 0,
+    ADDRESS_STATUS_CONTROL      = 1,
+    ADDRESS_CHANNEL_SELECT_LO   = 2,
+    ADDRESS_CHANNEL_SELECT_HI   = 3,
+    ADDRESS_SAMPLE_RATE_DIVISOR = 4,
+    ADDRESS_SAMPLE_CLOCK_CONTROL = 10,
+    ADDRESS_SAMPLE_MODE         = 16,
+    ADDRESS_TELEMETRY_CONTROL   = 25,
+    ADDRESS_TELEMETRY_DROPPED   = 26,
+    ADDRESS_TELEMETRY_HIGH_WATER = 30,
+    ADDRESS_TELEMETRY_WORDS     = 32,
+    ADDRESS_TELEMETRY_SAMPLES   = 36,
+    ADDRESS_SAMPLE_RATE_DIVISOR_MID = 40,
+    ADDRESS_SAMPLE_RATE_DIVISOR_HI = 41,
+    ADDRESS_BITSTREAM_ID        = 48,
+    ADDRESS_GLITCH_WIDTH        = 52,
+    ADDRESS_DECODER_UART_CONTROL = 60,
+    ADDRESS_DECODER_UART_BIT_PERIOD = 61,
+    ADDRESS_DECODER_SPI_CONTROL = 63,
+    ADDRESS_DECODER_SPI_CHANNELS = 64,
+    ADDRESS_DECODER_I2C_CONTROL = 66,
+    ADDRESS_DECODER_I2C_CHANNELS = 67,
+    ADDRESS_STATS_CONTROL       = 68,
+    ADDRESS_STATS_GATE          = 69,
+    ADDRESS_STATS_DATA          = 74,
+    ADDRESS_PEAK_WINDOW         = 75,
+};
+
+/* ADDRESS_SAMPLE_MODE encodings */
+enum encoding
+{
+    ENCODING_BLOCKS       = 0,
+    ENCODING_RLE          = 1, // loses runs shorter than two samples at divisor 0
+    ENCODING_TRANSITIONS  = 2,
+    ENCODING_SAMPLE_MAJOR = 3,
+    ENCODING_TEST_PATTERN = 4,
+    ENCODING_DECODED      = 5, // 4 word records from the protocol decoder, see decoder.vhd
+    ENCODING_STATISTICS   = 6, // nothing on ep2, see stats.vhd and device::statistics()
+};
+
+/* ADDRESS_SAMPLE_MODE bits above the encoding */
+const uint8_t SAMPLE_MODE_FLUSH = 0x20;
+
+/* ep2 buffering profiles, see fx2/gpif_stuff.h */
+enum profile
+{
+    PROFILE_512_QUAD    = 0,
+    PROFILE_1024_DOUBLE = 1,
+    PROFILE_1024_TRIPLE = 2,
+    PROFILE_1024_QUAD   = 3,
+    PROFILE_512_DOUBLE  = 4,
+    PROFILE_COUNT       = 5,
+};
+
+const char *profile_name(int profile);
+
+const unsigned EP_DATA_IN = 0x82;
+const double SAMPLE_CLOCK = 100e6;
+
+struct status
+{
+    bool done; // fpga is configured
+    uint8_t version;
+    uint32_t bitstream_id; // io standard in the low byte, build hash above
+};
+
+struct telemetry
+{
+    uint8_t flags; // bit0: fifo overrun, bit1: encoder overflow
+    uint32_t dropped;
+    uint16_t high_water;
+    uint32_t words;
+    uint32_t samples;
+};
+
+struct statistics
+{
+    bool valid; // a gate ended since sampling started
+    uint32_t gate; // number of the gate, counted from 1
+    uint32_t edges[16]; // rising and falling edges of each channel
+    uint32_t high[16]; // samples at high level of each channel
+    uint16_t saturated; // bit c: a count of channel c stopped at 2^24-1
+};
+
+/* all errors are thrown as std::runtime_error */
+class device
+{
+public:
+    device(); // opens the first logic16 found
+    ~device();
+    device(const device &) = delete;
+    device &operator=(const device &) = delete;
+
+    libusb_context *context() { return ctx; }
+    libusb_device_handle *handle() { return dev; }
+
+    /* send a command on ep1 and read reply_len bytes of reply */
+    void command(const std::vector<uint8_t> &cmd, uint8_t *reply = nullptr, size_t reply_len = 0);
+
+    void write_regs(const std::vector<std::pair<uint8_t, uint8_t>> &regs);
+    void write_reg(uint8_t addr, uint8_t val) { write_regs({{addr, val}}); }
+    void read_regs(uint8_t addr, uint8_t *vals, size_t count);
+    uint8_t read_reg(uint8_t addr);
+
+    struct status status();
+    /* upload over ep6, rle: data is compressed with host/rlepack */
+    void upload_bitstream(const std::vector<uint8_t> &data, bool rle);
+    void set_ep2_profile(int profile);
+    /* true: read one word per clock (default), false: the old waveform */
+    void set_gpif_flow(bool flow);
+    void set_sample_rate_divisor(uint32_t div);
+    /* minimum pulse width of each channel in sample clocks, 0 to 15 (0: off) */
+    void set_glitch_width(const uint8_t width[16]);
+    /* peak detect decimation: two samples per window of this many sample
+     * clocks, the min and the max of each channel (0 or 1: off, the sample
+     * rate divisor is ignored while on) */
+    void set_peak_window(uint16_t samples);
+    struct telemetry telemetry();
+    /* statistics mode: samples per gate (at least 33), and the results of the last gate */
+    void set_stats_gate(uint32_t samples);
+    struct statistics statistics();
+
+    /* start and stop the gpif and the sampling, sync: wait until the fx2
+     * confirms the gpif was aborted */
+    void start();
+    /* rle: write the run in progress, no more samples are encoded. call
+     * before stop() and keep reading ep2 until the record arrived */
+    void flush();
+    void stop(bool sync = false);
+
+private:
+    libusb_context *ctx = nullptr;
+    libusb_device_handle *dev = nullptr;
+};
+
+std::vector<uint8_t> read_file(const std::string &name);
+
+} // namespace logic16
+
+#endif /* LOGIC16_HPP */
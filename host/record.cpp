@@ -0,0 +1,287 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+/*
+ * capture the channel major stream (ENCODING_BLOCKS) to a file
+ *
+ * many bulk transfers are kept in flight on ep2 and each completed one is
+ * handed to the writer thread of a recorder (see recorder.hpp), so the usb
+ * events are never held up by the disk. with -e the device is replaced by
+ * the emulator, which sends the same stream, to benchmark the recorder and
+ * the disk without hardware. the summary shows the MB/s written and the
+ * dropouts: transfers lost because the writer fell behind, and with a
+ * device the words the fpga dropped because usb fell behind
+ *
+ * usage: record [options] file
+ *   -m mask      channel mask (default: ffff)
+ *   -d divisor   sample rate divisor (default: 9)
+ *   -c 0|1       sample clock 100MHz or 160MHz (default: 0)
+ *   -f clocks    glitch filter: remove pulses shorter than this many sample
+ *                clocks on all channels, 0 to 15 (default: 0, off)
+ *   -p clocks    peak detect: write a min and a max sample for each window
+ *                of this many sample clocks, a channel was low (0, 0), high
+ *                (1, 1) or toggled (0, 1) in it (default: 0, off, -d is
+ *                ignored when on)
+ *   -t seconds   duration (default: 10)
+ *   -q count     usb transfers queued (default: 16)
+ *   -s bytes     size of each transfer (default: 65536)
+ *   -n count     buffers between usb and the writer (default: 256)
+ *   -b file      upload this bitstream first (.rle: compressed)
+ *   -e MS/s      emulate the device at this sample rate, 0: as fast as
+ *                possible (-d and -c are ignored)
+ */
+
+#include "emulator.hpp"
+#include "logic16.hpp"
+#include "recorder.hpp"
+
+#include <libusb.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace logic16;
+
+namespace
+{
+
+struct options
+{
+    uint16_t mask = 0xffff;
+    uint32_t divisor = 9;
+    int clock = 0;
+    int glitch_width = 0;
+    int peak_window = 0;
+    double seconds = 10;
+    int queue = 16;
+    int transfer_size = 65536;
+    int buffers = 256;
+    std::string bitstream;
+    bool emulate = false;
+    double emulate_rate = 0;
+    std::string file;
+};
+
+/* shared by the transfer callbacks */
+struct capture
+{
+    recorder *rec;
+    bool running = false;
+    bool failed = false; // usb error
+    int pending = 0; // transfers submitted
+};
+
+/* commit the buffer and resubmit with a free one, or drop the data */
+void LIBUSB_CALL
+transfer_done(libusb_transfer *t)
+{
+    capture &c = *static_cast<capture *>(t->user_data);
+    if (t->status == LIBUSB_TRANSFER_COMPLETED || t->status == LIBUSB_TRANSFER_TIMED_OUT)
+    {
+        if (t->actual_length > 0)
+        {
+            uint8_t *next = c.rec->acquire();
+            if (next != nullptr)
+            {
+                c.rec->commit(t->buffer, t->actual_length);
+                t->buffer = next;
+            }
+            else
+            {
+                c.rec->drop(t->actual_length);
+            }
+        }
+    }
+    else if (t->status != LIBUSB_TRANSFER_CANCELLED)
+    {
+        c.failed = true;
+    }
+    if (c.running && !c.failed && libusb_submit_transfer(t) == 0)
+        return;
+    c.pending--;
+}
+
+/* returns the fpga telemetry at the end */
+struct telemetry
+capture_usb(device &dev, recorder &rec, const options &opt)
+{
+    std::vector<libusb_transfer *> transfers;
+    capture c;
+    c.rec = &rec;
+
+    dev.write_regs({{ADDRESS_CHANNEL_SELECT_LO, (uint8_t)opt.mask},
+                    {ADDRESS_CHANNEL_SELECT_HI, (uint8_t)(opt.mask >> 8)},
+                    {ADDRESS_SAMPLE_CLOCK_CONTROL, (uint8_t)opt.clock},
+                    {ADDRESS_SAMPLE_MODE, ENCODING_BLOCKS}});
+    dev.set_sample_rate_divisor(opt.divisor);
+    uint8_t width[16];
+    for (auto &w : width)
+        w = opt.glitch_width;
+    dev.set_glitch_width(width);
+    dev.set_peak_window(opt.peak_window);
+
+    c.running = true;
+    for (int i = 0; i < opt.queue; i++)
+    {
+        libusb_transfer *t = libusb_alloc_transfer(0);
+        libusb_fill_bulk_transfer(t, dev.handle(), EP_DATA_IN, rec.acquire(), opt.transfer_size, transfer_done,
+                                  &c, 1000);
+        transfers.push_back(t);
+        if (libusb_submit_transfer(t) == 0)
+            c.pending++;
+    }
+
+    dev.start();
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(opt.seconds);
+    while (std::chrono::steady_clock::now() < end && !c.failed)
+    {
+        timeval tv{0, 100000};
+        libusb_handle_events_timeout(dev.context(), &tv);
+    }
+    struct telemetry tel = dev.telemetry();
+
+    c.running = false;
+    for (auto t : transfers)
+        libusb_cancel_transfer(t);
+    while (c.pending > 0)
+        libusb_handle_events(dev.context());
+    for (auto t : transfers)
+        libusb_free_transfer(t);
+    dev.stop(true);
+    if (c.failed)
+        throw std::runtime_error("usb transfer failed");
+    return tel;
+}
+
+void
+usage(const char *name)
+{
+    std::fprintf(stderr, "usage: %s [-m mask] [-d divisor] [-c 0|1] [-f clocks] [-p clocks] [-t seconds] [-q count] [-s bytes] [-n count] "
+                 "[-b bitstream] [-e MS/s] file\n", name);
+    std::exit(2);
+}
+
+} // namespace
+
+
+int
+main(int argc, char **argv)
+{
+    options opt;
+
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (i + 1 >= argc || std::strlen(argv[i]) != 2)
+            usage(argv[0]);
+        const char *arg = argv[++i];
+        switch (argv[i - 1][1])
+        {
+        case 'm': opt.mask = std::strtoul(arg, nullptr, 16); break;
+        case 'd': opt.divisor = std::strtoul(arg, nullptr, 0); break;
+        case 'c': opt.clock = std::atoi(arg) != 0; break;
+        case 'f': opt.glitch_width = std::atoi(arg); break;
+        case 'p': opt.peak_window = std::atoi(arg); break;
+        case 't': opt.seconds = std::atof(arg); break;
+        case 'q': opt.queue = std::atoi(arg); break;
+        case 's': opt.transfer_size = std::atoi(arg); break;
+        case 'n': opt.buffers = std::atoi(arg); break;
+        case 'b': opt.bitstream = arg; break;
+        case 'e': opt.emulate = true; opt.emulate_rate = std::atof(arg) * 1e6; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (i + 1 != argc || opt.glitch_width < 0 || opt.glitch_width > 15 || opt.peak_window < 0 ||
+        opt.peak_window > 65535 || opt.queue <= 0 || opt.transfer_size <= 0 || opt.buffers <= 0)
+        usage(argv[0]);
+    opt.file = argv[i];
+
+    try
+    {
+        double clock = opt.clock ? 160e6 : SAMPLE_CLOCK;
+        double rate = clock / (opt.divisor + 1);
+        if (opt.peak_window > 1)
+            rate = clock * 2 / opt.peak_window; // a min and a max sample per window, the divisor is ignored
+        bool have_telemetry = false;
+        struct telemetry tel = {};
+        std::chrono::steady_clock::time_point start;
+
+        /* the transfers in flight hold a buffer each */
+        recorder rec(opt.file, opt.transfer_size, opt.queue + opt.buffers);
+        if (opt.emulate)
+        {
+            emulator emu(opt.mask, opt.emulate_rate);
+            rate = opt.emulate_rate;
+            std::printf("emulator, mask %04x, %.3f MS/s\n", opt.mask, rate / 1e6);
+            start = std::chrono::steady_clock::now();
+            emu.run(rec, opt.seconds);
+        }
+        else
+        {
+            device dev;
+            if (!opt.bitstream.empty())
+            {
+                bool rle = opt.bitstream.size() > 4 &&
+                           opt.bitstream.compare(opt.bitstream.size() - 4, 4, ".rle") == 0;
+                dev.set_ep2_profile(PROFILE_512_QUAD); // ep6 is needed for the upload
+                dev.upload_bitstream(read_file(opt.bitstream), rle);
+            }
+            if (!dev.status().done)
+                throw std::runtime_error("fpga not configured, use -b");
+            std::printf("mask %04x, %.3f MS/s, %d transfers of %d bytes\n", opt.mask, rate / 1e6, opt.queue,
+                        opt.transfer_size);
+            start = std::chrono::steady_clock::now();
+            tel = capture_usb(dev, rec, opt);
+            have_telemetry = true;
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        rec.finish();
+
+        record_stats st = rec.stats();
+        std::printf("%.1f MB in %.2f s: %.3f MB/s", st.bytes / 1e6, elapsed, st.bytes / elapsed / 1e6);
+        if (rate > 0)
+        {
+            unsigned channels = 0;
+            for (unsigned c = 0; c < 16; c++)
+                channels += (opt.mask >> c) & 1;
+            std::printf(" (stream %.3f MB/s)", rate * channels / 8 / 1e6);
+        }
+        std::printf("\ndropouts: %llu transfers, %llu bytes, buffer high-water %zu of %d\n",
+                    (unsigned long long)st.dropouts, (unsigned long long)st.dropped, st.high_water,
+                    opt.queue + opt.buffers);
+        if (have_telemetry)
+            std::printf("fpga: %u words dropped, fifo high-water %u\n", (unsigned)tel.dropped,
+                        (unsigned)tel.high_water);
+        if (st.dropouts > 0 || tel.dropped > 0)
+            return 1;
+    }
+    catch (std::exception &e)
+    {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
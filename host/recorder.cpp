@@ -0,0 +1,208 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#include "recorder.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace logic16
+{
+
+namespace
+{
+
+/* bytes of the file mapped at once, the file grows by this much */
+const uint64_t WINDOW = 64 << 20;
+
+std::runtime_error
+sys_error(const std::string &what)
+{
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+
+recorder::recorder(const std::string &file, size_t buffer_size, size_t buffers)
+    : size(buffer_size), count(buffers), free_buffers(buffers), full_buffers(buffers)
+{
+    if (buffer_size == 0 || buffer_size > UINT32_MAX || buffers == 0)
+        throw std::runtime_error("invalid recorder buffers");
+    pool.resize(buffer_size * buffers);
+    for (size_t i = 0; i < buffers; i++)
+        free_buffers.push(i);
+
+    fd = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw sys_error("can't open " + file);
+    thread = std::thread(&recorder::writer, this);
+}
+
+
+recorder::~recorder()
+{
+    try
+    {
+        finish();
+    }
+    catch (std::exception &)
+    {
+    }
+}
+
+
+uint8_t *
+recorder::acquire()
+{
+    uint32_t i;
+    if (!free_buffers.pop(i))
+        return nullptr;
+    return pool.data() + i * size;
+}
+
+
+void
+recorder::commit(uint8_t *buf, size_t len)
+{
+    /* can't fail, there are only count buffers */
+    full_buffers.push({(uint32_t)((buf - pool.data()) / size), (uint32_t)len});
+    size_t n = full_buffers.size();
+    if (n > high_water)
+        high_water = n;
+}
+
+
+void
+recorder::drop(size_t len)
+{
+    dropped += len;
+    dropouts++;
+}
+
+
+void
+recorder::finish()
+{
+    if (thread.joinable())
+    {
+        stopping.store(true, std::memory_order_release);
+        thread.join();
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    if (error)
+    {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+
+record_stats
+recorder::stats() const
+{
+    return {written.load(std::memory_order_relaxed), dropped, dropouts, high_water};
+}
+
+
+/*
+ * the window is remapped at each WINDOW boundary, the dirty pages of the
+ * old one are handed to writeback right away so they don't pile up in the
+ * page cache
+ */
+void
+recorder::writer()
+{
+    uint8_t *map = nullptr;
+    uint64_t map_offset = 0;
+    uint64_t pos = 0;
+
+    try
+    {
+        for (;;)
+        {
+            /* after stopping is seen every commit is visible */
+            bool stop = stopping.load(std::memory_order_acquire);
+            chunk c;
+            if (!full_buffers.pop(c))
+            {
+                if (stop)
+                    break;
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+
+            const uint8_t *src = pool.data() + c.index * size;
+            size_t left = c.len;
+            while (left > 0)
+            {
+                if (map == nullptr || pos == map_offset + WINDOW)
+                {
+                    if (map != nullptr)
+                    {
+                        msync(map, WINDOW, MS_ASYNC);
+                        munmap(map, WINDOW);
+                        map = nullptr;
+                    }
+                    map_offset = pos;
+                    if (ftruncate(fd, map_offset + WINDOW) < 0)
+                        throw sys_error("ftruncate");
+                    void *m = mmap(nullptr, WINDOW, PROT_READ | PROT_WRITE, MAP_SHARED, fd, map_offset);
+                    if (m == MAP_FAILED)
+                        throw sys_error("mmap");
+                    map = static_cast<uint8_t *>(m);
+                    madvise(map, WINDOW, MADV_SEQUENTIAL);
+                }
+                size_t n = map_offset + WINDOW - pos;
+                if (n > left)
+                    n = left;
+                std::memcpy(map + (pos - map_offset), src, n);
+                pos += n;
+                src += n;
+                left -= n;
+            }
+            written.store(pos, std::memory_order_relaxed);
+            free_buffers.push(c.index);
+        }
+    }
+    catch (std::exception &)
+    {
+        error = std::current_exception();
+    }
+
+    if (map != nullptr)
+        munmap(map, WINDOW);
+    if (ftruncate(fd, pos) < 0 && !error)
+        error = std::make_exception_ptr(sys_error("ftruncate"));
+}
+
+} // namespace logic16
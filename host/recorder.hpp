@@ -0,0 +1,115 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+/*
+ * capture to disk without ever blocking the usb reader
+ *
+ * the recorder owns a pool of transfer sized buffers. the reader (the usb
+ * callbacks or the emulator) takes a free buffer for each transfer it
+ * submits and commits the filled one, both through lock-free rings, and a
+ * writer thread appends the committed buffers to a memory mapped file and
+ * hands them back. if the writer falls behind and no buffer is free, the
+ * reader drops the transfer it just received instead of waiting: a dropout
+ */
+
+#ifndef RECORDER_HPP
+#define RECORDER_HPP
+
+#include "ring.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace logic16
+{
+
+struct record_stats
+{
+    uint64_t bytes; // written to the file
+    uint64_t dropped; // bytes lost in dropouts
+    uint64_t dropouts; // transfers lost
+    size_t high_water; // most buffers waiting for the writer
+};
+
+/* all errors are thrown as std::runtime_error */
+class recorder
+{
+public:
+    /* creates or truncates file, buffers of buffer_size bytes are allocated */
+    recorder(const std::string &file, size_t buffer_size, size_t buffers);
+    ~recorder();
+    recorder(const recorder &) = delete;
+    recorder &operator=(const recorder &) = delete;
+
+    size_t buffer_size() const { return size; }
+    size_t buffers() const { return count; }
+
+    /*
+     * reader side, from one thread only: acquire() returns a free buffer or
+     * nullptr if there is none, commit() queues a buffer from acquire() with
+     * len bytes for the writer, drop() counts a lost transfer of len bytes
+     */
+    uint8_t *acquire();
+    void commit(uint8_t *buf, size_t len);
+    void drop(size_t len);
+
+    /* write what was committed, stop the writer and truncate the file to
+     * its length. throws the writer's error if it failed */
+    void finish();
+
+    /* the writer's numbers are complete after finish() */
+    record_stats stats() const;
+
+private:
+    struct chunk
+    {
+        uint32_t index;
+        uint32_t len;
+    };
+
+    void writer();
+
+    size_t size;
+    size_t count;
+    std::vector<uint8_t> pool;
+    spsc_ring<uint32_t> free_buffers; // writer -> reader
+    spsc_ring<chunk> full_buffers; // reader -> writer
+    int fd = -1;
+
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+    std::exception_ptr error;
+    std::atomic<uint64_t> written{0};
+
+    // reader side
+    uint64_t dropped = 0;
+    uint64_t dropouts = 0;
+    size_t high_water = 0;
+};
+
+} // namespace logic16
+
+#endif /* RECORDER_HPP */
@@ -0,0 +1,96 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+/*
+ * lock-free ring for one producer thread and one consumer thread
+ *
+ * head is only written by the producer and tail only by the consumer, each
+ * publishes its slots with a release store that the other side loads with
+ * acquire. neither side ever waits for the other, push() fails when the
+ * ring is full and pop() when it is empty
+ */
+
+#ifndef RING_HPP
+#define RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace logic16
+{
+
+template <typename T>
+class spsc_ring
+{
+public:
+    /* capacity is rounded up to a power of two */
+    explicit spsc_ring(size_t capacity)
+    {
+        size_t n = 1;
+        while (n < capacity)
+            n *= 2;
+        slots.resize(n);
+        mask = n - 1;
+    }
+
+    size_t capacity() const { return slots.size(); }
+
+    /* producer side */
+    bool push(const T &v)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == slots.size())
+            return false;
+        slots[h & mask] = v;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* consumer side */
+    bool pop(T &v)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t)
+            return false;
+        v = slots[t & mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* entries in the ring, exact on either side as long as the other one
+     * doesn't move */
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> slots;
+    size_t mask;
+    /* on their own cache lines, the two threads write one each */
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+} // namespace logic16
+
+#endif /* RING_HPP */
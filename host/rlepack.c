@@ -0,0 +1,240 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * rle compression of fpga bitstreams for the compressed upload of the fx2
+ * firmware (fpga_upload_rle() in fx2/fpga.c)
+ *
+ * the compressed data is a sequence of tokens:
+ *   0x00-0x7f  followed by token+1 literal bytes (1-128)
+ *   0x80-0xff  followed by one byte which is repeated (token&0x7f)+3 times (3-130)
+ *
+ * usage: rlepack [-d] input output
+ *   -d  decompress
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LITERAL_MAX  128
+#define RUN_MIN      3
+#define RUN_MAX      (127 + RUN_MIN)
+
+
+static unsigned char *
+read_file(const char *name, size_t *len)
+{
+    FILE *f;
+    unsigned char *buf = NULL;
+    size_t size = 0, n;
+
+    f = fopen(name, "rb");
+    if (f == NULL)
+    {
+        perror(name);
+        return NULL;
+    }
+    *len = 0;
+    do
+    {
+        if (*len == size)
+        {
+            size = size ? 2*size : 65536;
+            buf = realloc(buf, size);
+            if (buf == NULL)
+            {
+                fprintf(stderr, "out of memory\n");
+                fclose(f);
+                return NULL;
+            }
+        }
+        n = fread(buf + *len, 1, size - *len, f);
+        *len += n;
+    }
+    while (n > 0);
+    if (ferror(f))
+    {
+        perror(name);
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+
+static size_t
+run_length(const unsigned char *data, size_t len)
+{
+    size_t n = 1;
+    while (n < len && n < RUN_MAX && data[n] == data[0])
+        n++;
+    return n;
+}
+
+
+/* out needs len + len/LITERAL_MAX + 1 bytes */
+static size_t
+compress(const unsigned char *in, size_t len, unsigned char *out)
+{
+    size_t i = 0, o = 0, literal = 0, n;
+    int have_literal = 0; /* out[literal] is an open literal token */
+
+    while (i < len)
+    {
+        n = run_length(in + i, len - i);
+        if (n >= RUN_MIN)
+        {
+            out[o++] = 0x80 | (n - RUN_MIN);
+            out[o++] = in[i];
+            i += n;
+            have_literal = 0;
+            continue;
+        }
+        /* extend literal token, start a new one when full */
+        if (!have_literal || out[literal] == LITERAL_MAX - 1)
+        {
+            literal = o;
+            out[o++] = 0;
+            have_literal = 1;
+        }
+        else
+        {
+            out[literal]++;
+        }
+        out[o++] = in[i++];
+    }
+    return o;
+}
+
+
+/* returns decompressed length or -1 on malformed data, out may be NULL */
+static long
+decompress(const unsigned char *in, size_t len, unsigned char *out)
+{
+    size_t i = 0, o = 0, n;
+
+    while (i < len)
+    {
+        unsigned char token = in[i++];
+        if (token & 0x80)
+        {
+            n = (token & 0x7f) + RUN_MIN;
+            if (i >= len)
+                return -1;
+            if (out != NULL)
+                memset(out + o, in[i], n);
+            i++;
+        }
+        else
+        {
+            n = token + 1;
+            if (i + n > len)
+                return -1;
+            if (out != NULL)
+                memcpy(out + o, in + i, n);
+            i += n;
+        }
+        o += n;
+    }
+    return o;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    int decomp = 0;
+    unsigned char *in, *out;
+    size_t in_len;
+    long out_len;
+    FILE *f;
+
+    if (argc == 4 && strcmp(argv[1], "-d") == 0)
+    {
+        decomp = 1;
+        argv++;
+        argc--;
+    }
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s [-d] input output\n", argv[0]);
+        return 2;
+    }
+
+    in = read_file(argv[1], &in_len);
+    if (in == NULL)
+        return 1;
+
+    if (decomp)
+    {
+        out_len = decompress(in, in_len, NULL);
+        if (out_len < 0)
+        {
+            fprintf(stderr, "%s: malformed data\n", argv[1]);
+            return 1;
+        }
+        out = malloc(out_len + 1);
+        if (out == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        decompress(in, in_len, out);
+    }
+    else
+    {
+        out = malloc(in_len + in_len/LITERAL_MAX + 1);
+        if (out == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        out_len = compress(in, in_len, out);
+
+        /* check the round trip before writing anything */
+        unsigned char *check = malloc(in_len + 1);
+        if (check == NULL || decompress(out, out_len, check) != (long)in_len ||
+            memcmp(check, in, in_len) != 0)
+        {
+            fprintf(stderr, "%s: compression failed\n", argv[1]);
+            return 1;
+        }
+        free(check);
+        printf("%s: %zu -> %ld bytes\n", argv[2], in_len, out_len);
+    }
+
+    f = fopen(argv[2], "wb");
+    if (f == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+    if (fwrite(out, 1, out_len, f) != (size_t)out_len || fclose(f) != 0)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    free(in);
+    free(out);
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * frequency and duty cycle of all 16 channels (ENCODING_STATISTICS)
+ *
+ * the fpga counts the edges and the high samples of each channel over a
+ * gate and latches them at its end, the results of each gate are read over
+ * ep1 and printed. ep2 stays idle, so this can run for any time without
+ * usb load. gates which ended between two reads are reported as missed.
+ * the resolution is one sample, so a higher sample rate gives better duty
+ * cycles, the frequency of a channel must stay below half the sample rate.
+ * the counters have 24 bits, channels which reached 2^24-1 edges or high
+ * samples in a gate are marked "sat" (use a shorter gate)
+ *
+ * usage: stats [options]
+ *   -d divisor   sample rate divisor (default: 0)
+ *   -c 0|1       sample clock 100MHz or 160MHz (default: 0)
+ *   -f clocks    glitch filter on all channels, 0 to 15 (default: 0, off)
+ *   -g ms        gate time (default: 1000)
+ *   -n count     gates to print, 0: until interrupted (default: 1)
+ *   -b file      upload this bitstream first (.rle: compressed)
+ */
+
+#include "logic16.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace logic16;
+
+namespace
+{
+
+struct options
+{
+    uint32_t divisor = 0;
+    int clock = 0;
+    int glitch_width = 0;
+    double gate_ms = 1000;
+    unsigned count = 1;
+    std::string bitstream;
+};
+
+void
+print_frequency(double hz)
+{
+    if (hz >= 1e6)
+        std::printf("%12.6f MHz", hz / 1e6);
+    else if (hz >= 1e3)
+        std::printf("%12.6f kHz", hz / 1e3);
+    else
+        std::printf("%12.6f Hz ", hz);
+}
+
+void
+usage(const char *name)
+{
+    std::fprintf(stderr, "usage: %s [-d divisor] [-c 0|1] [-f clocks] [-g ms] [-n count] [-b bitstream]\n", name);
+    std::exit(2);
+}
+
+} // namespace
+
+
+int
+main(int argc, char **argv)
+{
+    options opt;
+
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (i + 1 >= argc || std::strlen(argv[i]) != 2)
+            usage(argv[0]);
+        const char *arg = argv[++i];
+        switch (argv[i - 1][1])
+        {
+        case 'd': opt.divisor = std::strtoul(arg, nullptr, 0); break;
+        case 'c': opt.clock = std::atoi(arg) != 0; break;
+        case 'f': opt.glitch_width = std::atoi(arg); break;
+        case 'g': opt.gate_ms = std::atof(arg); break;
+        case 'n': opt.count = std::strtoul(arg, nullptr, 0); break;
+        case 'b': opt.bitstream = arg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (i != argc || opt.glitch_width < 0 || opt.glitch_width > 15 || !(opt.gate_ms > 0))
+        usage(argv[0]);
+
+    try
+    {
+        double rate = (opt.clock ? 160e6 : SAMPLE_CLOCK) / (opt.divisor + 1);
+        double samples = std::round(opt.gate_ms * 1e-3 * rate);
+        if (samples < 33 || samples > 4294967295.0)
+            throw std::runtime_error("gate must be 33 to 2^32-1 samples");
+        uint32_t gate_samples = (uint32_t)samples;
+        double gate_time = gate_samples / rate;
+
+        device dev;
+        if (!opt.bitstream.empty())
+        {
+            bool rle = opt.bitstream.size() > 4 &&
+                       opt.bitstream.compare(opt.bitstream.size() - 4, 4, ".rle") == 0;
+            dev.set_ep2_profile(PROFILE_512_QUAD); // ep6 is needed for the upload
+            dev.upload_bitstream(read_file(opt.bitstream), rle);
+        }
+        if (!dev.status().done)
+            throw std::runtime_error("fpga not configured, use -b");
+
+        dev.write_regs({{ADDRESS_SAMPLE_CLOCK_CONTROL, (uint8_t)opt.clock},
+                        {ADDRESS_SAMPLE_MODE, ENCODING_STATISTICS}});
+        dev.set_sample_rate_divisor(opt.divisor);
+        uint8_t width[16];
+        for (auto &w : width)
+            w = opt.glitch_width;
+        dev.set_glitch_width(width);
+        dev.set_stats_gate(gate_samples);
+        std::printf("%.3f MS/s, gate %u samples (%.6f s)\n", rate / 1e6, (unsigned)gate_samples, gate_time);
+
+        /* sample without the gpif, nothing is sent on ep2 */
+        dev.write_reg(ADDRESS_STATUS_CONTROL, 0x41);
+        auto poll = std::chrono::duration<double>(std::min(gate_time / 4, 0.1));
+        uint32_t last_gate = 0;
+        for (unsigned printed = 0; opt.count == 0 || printed < opt.count; )
+        {
+            std::this_thread::sleep_for(poll);
+            struct statistics s = dev.statistics();
+            if (!s.valid || s.gate == last_gate)
+                continue;
+            std::printf("\ngate %u", (unsigned)s.gate);
+            if (s.gate - last_gate > 1)
+                std::printf(" (%u missed)", (unsigned)(s.gate - last_gate - 1));
+            std::printf("\nch        frequency    duty     edges\n");
+            for (int c = 0; c < 16; c++)
+            {
+                std::printf("%2d  ", c);
+                print_frequency(s.edges[c] / 2.0 / gate_time);
+                std::printf("  %5.1f%%  %8u%s\n", 100.0 * s.high[c] / gate_samples, (unsigned)s.edges[c],
+                            (s.saturated >> c) & 1 ? "  sat" : "");
+            }
+            std::fflush(stdout);
+            last_gate = s.gate;
+            printed++;
+        }
+        dev.write_reg(ADDRESS_STATUS_CONTROL, 0x00);
+    }
+    catch (std::exception &e)
+    {
+        std::fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
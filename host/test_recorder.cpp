@@ -0,0 +1,204 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+/*
+ * self checking test of the recorder (run with "make test")
+ *
+ * the ring is run between two threads, the emulator's stream is decoded
+ * back to its counter, and the emulator records into a temporary file of
+ * more than one mapped window, which is read back: it must hold every
+ * transfer that wasn't dropped, in order, each one a piece of the counter
+ */
+
+#include "emulator.hpp"
+#include "recorder.hpp"
+#include "ring.hpp"
+#include "transpose.hpp"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace logic16;
+
+namespace
+{
+
+int failures = 0;
+
+void
+fail(const char *what, uint16_t mask, size_t where)
+{
+    std::printf("test_recorder: %s, mask %04x, at %zu\n", what, mask, where);
+    failures++;
+}
+
+void
+test_ring()
+{
+    const uint32_t count = 1000000;
+    spsc_ring<uint32_t> ring(60);
+    if (ring.capacity() != 64)
+        fail("ring capacity", 0, ring.capacity());
+
+    std::thread producer([&]()
+    {
+        for (uint32_t i = 0; i < count; i++)
+            while (!ring.push(i))
+                std::this_thread::yield();
+    });
+    uint32_t expected = 0;
+    while (expected < count)
+    {
+        uint32_t v;
+        if (!ring.pop(v))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (v != expected)
+        {
+            fail("ring order", 0, expected);
+            break;
+        }
+        expected++;
+    }
+    producer.join();
+}
+
+/* the samples of data must count up by one, from first if it isn't -1 */
+void
+check_counter(block_decoder &dec, uint16_t mask, const uint8_t *data, size_t len, long first, size_t where)
+{
+    std::vector<uint16_t> samples(dec.max_samples(len));
+    size_t n = dec.decode(data, len, samples.data());
+    if (n != samples.size() || n == 0)
+    {
+        fail("sample count", mask, where);
+        return;
+    }
+    uint16_t s = first >= 0 ? first : samples[0];
+    for (size_t i = 0; i < n; i++, s++)
+    {
+        if (samples[i] != (s & mask))
+        {
+            fail("counter", mask, where + i);
+            return;
+        }
+    }
+}
+
+void
+test_emulator(uint16_t mask)
+{
+    emulator emu(mask, 0);
+    block_decoder dec(mask);
+    /* more than one period of the counter, in odd pieces */
+    std::vector<uint8_t> stream(emu.block_size() * 5000);
+    size_t pos = 0;
+    while (pos < stream.size())
+    {
+        size_t len = stream.size() - pos < 777 ? stream.size() - pos : 777;
+        emu.fill(stream.data() + pos, len);
+        pos += len;
+    }
+    check_counter(dec, mask, stream.data(), stream.size(), 0, 0);
+}
+
+/* mask at sample_rate for seconds, transfers which aren't a divisor of the
+ * mapped window */
+void
+test_record(uint16_t mask, double sample_rate, double seconds)
+{
+    char name[] = "/tmp/test_recorder.XXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0)
+    {
+        fail("mkstemp", mask, 0);
+        return;
+    }
+    close(fd);
+
+    emulator emu(mask, sample_rate);
+    const size_t transfer = emu.block_size() * 3000;
+    record_stats st;
+    {
+        recorder rec(name, transfer, 128);
+        emu.run(rec, seconds);
+        rec.finish();
+        st = rec.stats();
+    }
+
+    std::FILE *f = std::fopen(name, "rb");
+    std::vector<uint8_t> data;
+    if (f != nullptr)
+    {
+        std::vector<uint8_t> buf(1 << 20);
+        size_t n;
+        while ((n = std::fread(buf.data(), 1, buf.size(), f)) > 0)
+            data.insert(data.end(), buf.begin(), buf.begin() + n);
+        std::fclose(f);
+    }
+    std::remove(name);
+
+    if (data.size() != st.bytes || st.bytes % transfer != 0 || st.dropped != st.dropouts * transfer)
+    {
+        fail("file size", mask, data.size());
+        return;
+    }
+    if (st.bytes < (64 << 20))
+        fail("less than a window recorded", mask, st.bytes);
+    /* without dropouts the whole file is one stream */
+    block_decoder dec(mask);
+    for (size_t pos = 0; pos < data.size(); pos += transfer)
+    {
+        if (st.dropouts > 0)
+            dec.reset();
+        long first = st.dropouts == 0 ? pos / emu.block_size() * 16 % 65536 : -1;
+        check_counter(dec, mask, data.data() + pos, transfer, first, pos);
+    }
+    std::printf("test_recorder: mask %04x, %.1f MB, %llu dropouts, high-water %zu\n", mask, st.bytes / 1e6,
+                (unsigned long long)st.dropouts, st.high_water);
+}
+
+} // namespace
+
+
+int
+main()
+{
+    test_ring();
+    for (uint16_t mask : {0xffff, 0x0001, 0x0007, 0xa5a5})
+        test_emulator(mask);
+    test_record(0xffff, 40e6, 1.0); // 80 MB/s
+    test_record(0x0007, 200e6, 1.0); // 75 MB/s
+
+    if (failures > 0)
+    {
+        std::printf("test_recorder: %d failures\n", failures);
+        return 1;
+    }
+    std::printf("test_recorder: ok\n");
+    return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * self checking test of the block decoder (run with "make test")
+ *
+ * random input pins are encoded by a model of sample.vhd and the stream is
+ * decoded again with every kernel the cpu supports, for a number of channel
+ * masks, in one piece and in random pieces, with and without ddr
+ */
+
+#include "transpose.hpp"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace logic16;
+
+namespace
+{
+
+/*
+ * sample.vhd with input_shiftreg.vhd: each sample is shifted into the lsb
+ * of the shift register of its channel (ddr: the rising and the falling
+ * edge sample at once), after 16 samples fifo_write_sequence writes the
+ * registers of the selected channels (ddr: channels 0-7 only) in order.
+ * samples of an incomplete block are never written
+ */
+std::vector<uint8_t>
+encode(const std::vector<uint16_t> &pins, uint16_t channel_select, bool ddr)
+{
+    std::vector<uint8_t> stream;
+    uint16_t shiftreg[16] = {0};
+    unsigned count = 0;
+    const unsigned channels = ddr ? 8 : 16;
+
+    for (uint16_t p : pins)
+    {
+        for (unsigned i = 0; i < 16; i++)
+            shiftreg[i] = (shiftreg[i] << 1) | ((p >> i) & 1);
+        if (++count < 16)
+            continue;
+        count = 0;
+        for (unsigned i = 0; i < channels; i++)
+        {
+            if (channel_select & (1 << i))
+            {
+                stream.push_back(shiftreg[i] & 0xff);
+                stream.push_back(shiftreg[i] >> 8);
+            }
+        }
+    }
+    return stream;
+}
+
+int failures = 0;
+
+void
+check(const char *what, int kernel, uint16_t mask, bool ddr, const std::vector<uint16_t> &expected,
+      const std::vector<uint16_t> &got)
+{
+    if (got == expected)
+        return;
+    size_t i = 0;
+    while (i < expected.size() && i < got.size() && got[i] == expected[i])
+        i++;
+    std::printf("test_transpose: %s, %s, mask %04x%s: %zu samples, expected %zu, first difference at %zu\n",
+                what, kernel_name(kernel), mask, ddr ? ", ddr" : "", got.size(), expected.size(), i);
+    failures++;
+}
+
+void
+test(std::mt19937 &rng, int kernel, uint16_t mask, bool ddr)
+{
+    /* a few hundred blocks, not a multiple of 16 samples */
+    std::vector<uint16_t> pins(16 * 300 + 7);
+    for (auto &p : pins)
+        p = rng();
+    if (ddr)
+    {
+        /* only channels 0-7 are sampled */
+        mask &= 0x00ff;
+        if (mask == 0)
+            mask = 1;
+        for (auto &p : pins)
+            p &= 0x00ff;
+    }
+    std::vector<uint8_t> stream = encode(pins, mask, ddr);
+
+    std::vector<uint16_t> expected(pins.begin(), pins.begin() + pins.size() / 16 * 16);
+    for (auto &e : expected)
+        e &= mask;
+
+    block_decoder dec(mask, kernel);
+    std::vector<uint16_t> got(dec.max_samples(stream.size()));
+    got.resize(dec.decode(stream.data(), stream.size(), got.data()));
+    check("one piece", kernel, mask, ddr, expected, got);
+
+    /* random pieces, including empty ones and pieces within one word */
+    dec.reset();
+    got.clear();
+    size_t pos = 0;
+    while (pos < stream.size())
+    {
+        size_t len = rng() % 100;
+        if (len > stream.size() - pos)
+            len = stream.size() - pos;
+        std::vector<uint16_t> out(dec.max_samples(len));
+        size_t n = dec.decode(stream.data() + pos, len, out.data());
+        if (n > out.size())
+        {
+            std::printf("test_transpose: max_samples too small\n");
+            failures++;
+            return;
+        }
+        got.insert(got.end(), out.begin(), out.begin() + n);
+        pos += len;
+    }
+    check("pieces", kernel, mask, ddr, expected, got);
+}
+
+} // namespace
+
+
+int
+main()
+{
+    std::mt19937 rng(1);
+    std::vector<uint16_t> masks{0xffff, 0x0001, 0x8000, 0x00ff, 0xff00, 0xa5a5, 0x7ffe};
+    for (int i = 0; i < 20; i++)
+        masks.push_back(rng() | 1);
+    int kernels = 0;
+
+    for (int k = 0; k < KERNEL_COUNT; k++)
+    {
+        if (!kernel_supported(k))
+        {
+            std::printf("test_transpose: %s not supported, skipped\n", kernel_name(k));
+            continue;
+        }
+        kernels++;
+        for (uint16_t mask : masks)
+        {
+            test(rng, k, mask, false);
+            test(rng, k, mask, true);
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::printf("test_transpose: %d failures\n", failures);
+        return 1;
+    }
+    std::printf("test_transpose: %d kernels, %zu channel masks ok\n", kernels, masks.size());
+    return 0;
+}
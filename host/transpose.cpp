@@ -0,0 +1,231 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "transpose.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TRANSPOSE_X86
+#include <immintrin.h>
+#endif
+
+namespace logic16
+{
+
+namespace
+{
+
+/*
+ * the block is a 16x16 bit matrix with the first sample in the msb of each
+ * word. with the channels in reverse order the transpose (hacker's delight,
+ * swap the off diagonal halves, then quarters, ...) puts channel c in bit c
+ */
+void
+transpose_scalar(const uint8_t *block, uint16_t *samples)
+{
+    uint16_t a[16];
+    for (int c = 0; c < 16; c++)
+        a[15 - c] = block[2 * c] | (block[2 * c + 1] << 8);
+
+    unsigned j = 8;
+    uint16_t m = 0x00ff;
+    for (; j != 0; j >>= 1, m ^= m << j)
+    {
+        for (unsigned k = 0; k < 16; k = (k + j + 1) & ~j)
+        {
+            uint16_t t = (a[k] ^ (a[k + j] >> j)) & m;
+            a[k] ^= t;
+            a[k + j] ^= t << j;
+        }
+    }
+    std::memcpy(samples, a, sizeof(a));
+}
+
+#ifdef TRANSPOSE_X86
+
+/*
+ * the simd kernels gather the high bytes (samples 0-7) and the low bytes
+ * (samples 8-15) of all channels, byte c for channel c. movemask then
+ * collects the msb of each byte, which is one sample, and adding the vector
+ * to itself moves the next sample up
+ */
+__attribute__((target("sse2"))) void
+transpose_sse2(const uint8_t *block, uint16_t *samples)
+{
+    const __m128i low_mask = _mm_set1_epi16(0x00ff);
+    __m128i a = _mm_loadu_si128((const __m128i *)block); // channels 0-7
+    __m128i b = _mm_loadu_si128((const __m128i *)(block + 16)); // channels 8-15
+    __m128i hi = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+    __m128i lo = _mm_packus_epi16(_mm_and_si128(a, low_mask), _mm_and_si128(b, low_mask));
+
+    for (int i = 0; i < 8; i++)
+    {
+        samples[i] = _mm_movemask_epi8(hi);
+        samples[i + 8] = _mm_movemask_epi8(lo);
+        hi = _mm_add_epi8(hi, hi);
+        lo = _mm_add_epi8(lo, lo);
+    }
+}
+
+/* same with the high bytes in the low lane and the low bytes in the high lane */
+__attribute__((target("avx2"))) void
+transpose_avx2(const uint8_t *block, uint16_t *samples)
+{
+    const __m256i split = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+                                           0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    __m256i v = _mm256_loadu_si256((const __m256i *)block);
+    /* qwords: low 0-7, high 0-7, low 8-15, high 8-15 */
+    v = _mm256_shuffle_epi8(v, split);
+    v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(2, 0, 3, 1));
+
+    for (int i = 0; i < 8; i++)
+    {
+        uint32_t m = _mm256_movemask_epi8(v);
+        samples[i] = m;
+        samples[i + 8] = m >> 16;
+        v = _mm256_add_epi8(v, v);
+    }
+}
+
+#endif /* TRANSPOSE_X86 */
+
+} // namespace
+
+
+const char *
+kernel_name(int k)
+{
+    static const char *names[KERNEL_COUNT] = {"scalar", "sse2", "avx2"};
+    if (k < 0 || k >= KERNEL_COUNT)
+        return "?";
+    return names[k];
+}
+
+
+bool
+kernel_supported(int k)
+{
+    switch (k)
+    {
+    case KERNEL_SCALAR:
+        return true;
+#ifdef TRANSPOSE_X86
+    case KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+
+int
+best_kernel()
+{
+    for (int k = KERNEL_COUNT - 1; k > KERNEL_SCALAR; k--)
+        if (kernel_supported(k))
+            return k;
+    return KERNEL_SCALAR;
+}
+
+
+transpose_fn
+transpose_kernel(int k)
+{
+    if (!kernel_supported(k))
+        throw std::runtime_error(std::string("kernel not supported: ") + kernel_name(k));
+    switch (k)
+    {
+#ifdef TRANSPOSE_X86
+    case KERNEL_SSE2: return transpose_sse2;
+    case KERNEL_AVX2: return transpose_avx2;
+#endif
+    default: return transpose_scalar;
+    }
+}
+
+
+block_decoder::block_decoder(uint16_t channel_mask, int k)
+    : transpose(transpose_kernel(k))
+{
+    for (int c = 0; c < 16; c++)
+        if (channel_mask & (1 << c))
+            channels.push_back(c);
+    if (channels.empty())
+        throw std::runtime_error("no channel selected");
+    full = channels.size() == 16;
+}
+
+
+void
+block_decoder::expand(const uint8_t *words)
+{
+    for (size_t i = 0; i < channels.size(); i++)
+        std::memcpy(block + 2 * channels[i], words + 2 * i, 2);
+}
+
+
+size_t
+block_decoder::decode(const uint8_t *data, size_t len, uint16_t *samples)
+{
+    const size_t size = block_size();
+    size_t n = 0;
+
+    if (pending > 0)
+    {
+        /* complete the block left over from the last call */
+        size_t count = size - pending < len ? size - pending : len;
+        std::memcpy(partial + pending, data, count);
+        pending += count;
+        data += count;
+        len -= count;
+        if (pending < size)
+            return 0;
+        expand(partial);
+        transpose(block, samples);
+        n = 16;
+        pending = 0;
+    }
+
+    if (full)
+    {
+        for (; len >= size; data += size, len -= size, n += 16)
+            transpose(data, samples + n);
+    }
+    else
+    {
+        for (; len >= size; data += size, len -= size, n += 16)
+        {
+            expand(data);
+            transpose(block, samples + n);
+        }
+    }
+
+    std::memcpy(partial, data, len);
+    pending = len;
+    return n;
+}
+
+} // namespace logic16
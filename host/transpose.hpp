@@ -0,0 +1,96 @@
+/*
+ * This file is part of the la16fw project.
+ *
+ * Copyright (C) 2014-2015 Gregor Anich
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * decoder for the channel major sample stream (ENCODING_BLOCKS)
+ *
+ * the fpga collects 16 samples in the input shift registers and then sends
+ * one 16 bit word for each enabled channel, lowest channel first (see
+ * input_shiftreg.vhd and fifo_write_sequence in sample.vhd). the msb of a
+ * word is the first of the 16 samples, words are little endian on usb.
+ * decoding is a 16x16 bit transpose per block, there are scalar, sse2 and
+ * avx2 kernels for it, the fastest one the cpu supports is used by default
+ */
+
+#ifndef TRANSPOSE_HPP
+#define TRANSPOSE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace logic16
+{
+
+enum kernel
+{
+    KERNEL_SCALAR = 0,
+    KERNEL_SSE2   = 1,
+    KERNEL_AVX2   = 2,
+    KERNEL_COUNT  = 3,
+};
+
+/*
+ * transpose one full block: 32 bytes, the words of channels 0 to 15, to 16
+ * samples with channel c in bit c
+ */
+typedef void (*transpose_fn)(const uint8_t *block, uint16_t *samples);
+
+const char *kernel_name(int k);
+bool kernel_supported(int k);
+int best_kernel();
+/* throws std::runtime_error if the kernel isn't supported */
+transpose_fn transpose_kernel(int k);
+
+/* decodes a stream in pieces of any size, for any channel mask */
+class block_decoder
+{
+public:
+    /* throws std::runtime_error if no channel is selected */
+    explicit block_decoder(uint16_t channel_mask, int k = best_kernel());
+
+    /* bytes per block of 16 samples */
+    size_t block_size() const { return 2 * channels.size(); }
+    /* samples decode() writes at most for len bytes */
+    size_t max_samples(size_t len) const { return 16 * ((pending + len) / block_size()); }
+
+    /*
+     * decode len bytes, 16 samples are written for each complete block and
+     * the rest is kept for the next call. returns the number of samples,
+     * disabled channels are 0
+     */
+    size_t decode(const uint8_t *data, size_t len, uint16_t *samples);
+    /* start at a block boundary again, e.g. for a new acquisition */
+    void reset() { pending = 0; }
+
+private:
+    void expand(const uint8_t *words);
+
+    transpose_fn transpose;
+    std::vector<uint8_t> channels; // enabled channels in stream order
+    bool full; // all 16 channels, the stream is made of full blocks
+    uint8_t block[32] = {0}; // full block, disabled channels stay 0
+    uint8_t partial[32]; // incomplete block from the last call
+    size_t pending = 0; // bytes in partial
+};
+
+} // namespace logic16
+
+#endif /* TRANSPOSE_HPP */
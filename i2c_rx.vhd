@@ -0,0 +1,97 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+----------------------------------------------------------------------------------
+--
+-- i2c receiver for the protocol decoder, works on the sampled lines
+--
+-- sda falling while scl is high is a (repeated) start, sda rising while scl is
+-- high a stop, both are strobed as events. between them sda is taken on each
+-- rising edge of scl, 8 data bits msb first and the ack bit, the byte is
+-- strobed with the ack bit ('1': nack). the address byte is the first byte
+-- after a start
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity i2c_rx is
+    port(
+        clk        : in std_logic;
+        enable     : in std_logic; -- '1' to receive, '0' to reset
+        scl        : in std_logic;
+        sda        : in std_logic;
+        data_valid : in std_logic; -- scl and sda hold a new sample
+        data       : out std_logic_vector(7 downto 0) := (others=>'0'); -- 0 for start and stop
+        flags      : out std_logic_vector(2 downto 0) := (others=>'0'); -- bit0: ack bit of the byte, bit1: start, bit2: stop
+        strobe     : out std_logic := '0' -- data and flags hold a byte or an event
+    );
+end i2c_rx;
+
+
+architecture behavioral of i2c_rx is
+
+    signal last_scl  : std_logic := '1';
+    signal last_sda  : std_logic := '1';
+    signal active    : std_logic := '0'; -- between start and stop
+    signal bit_count : unsigned(3 downto 0);
+    signal shiftreg  : std_logic_vector(7 downto 0);
+
+begin
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            strobe <= '0';
+            if (data_valid = '1') then
+                last_scl <= scl;
+                last_sda <= sda;
+                if (scl = '1') and (last_scl = '1') and (sda /= last_sda) then
+                    -- start or stop
+                    data <= (others=>'0');
+                    flags <= sda & not sda & '0';
+                    strobe <= '1';
+                    active <= not sda;
+                    bit_count <= (others=>'0');
+                elsif (active = '1') and (scl = '1') and (last_scl = '0') then
+                    bit_count <= bit_count + 1;
+                    if (bit_count = 8) then
+                        data <= shiftreg;
+                        flags <= "00" & sda;
+                        strobe <= '1';
+                        bit_count <= (others=>'0');
+                    else
+                        shiftreg <= shiftreg(6 downto 0) & sda;
+                    end if;
+                end if;
+            end if;
+
+            -- reset, scl must be seen high before the first start
+            if (enable = '0') then
+                last_scl <= '0';
+                last_sda <= '1';
+                active <= '0';
+            end if;
+        end if;
+    end process;
+
+end behavioral;
@@ -27,7 +27,9 @@ entity input_shiftreg is
     port(
         clk       : in std_logic;
         shift_in  : in std_logic;
+        double    : in std_logic := '0'; -- shift in data_in and data_in_2 at once
         data_in   : in std_logic_vector(15 downto 0);
+        data_in_2 : in std_logic_vector(15 downto 0) := (others=>'0'); -- sample after data_in
         shift_out : in std_logic;
         data_out  : out std_logic_vector(15 downto 0)
     );
@@ -53,7 +55,11 @@ begin
             if (shift_in = '1') then
                 -- shift input data into shift regs (msb is first sample)
                 for i in 0 to 15 loop
-                    shiftreg(i) <= shiftreg(i)(14 downto 0) & data_in(i);
+                    if (double = '1') then
+                        shiftreg(i) <= shiftreg(i)(13 downto 0) & data_in(i) & data_in_2(i);
+                    else
+                        shiftreg(i) <= shiftreg(i)(14 downto 0) & data_in(i);
+                    end if;
                 end loop;
             elsif (shift_out = '1') then
                 shiftreg <= vector16_null & shiftreg(15 downto 1);
@@ -31,7 +31,9 @@ use ieee.numeric_std.all;
 
 entity mainmodule is
     generic(
-        -- spi addresses
+        -- spi addresses. a read burst also loads the register after its
+        -- last byte, registers with a side effect on reading (ADDRESS_STATS_DATA)
+        -- only act on bytes that were sent (spi read_done)
         ADDRESS_FPGA_VERSION : integer := 0;
         ADDRESS_STATUS_CONTROL : integer := 1;
         ADDRESS_CHANNEL_SELECT_LO : integer := 2;
@@ -39,9 +41,45 @@ entity mainmodule is
         ADDRESS_SAMPLE_RATE_DIVISOR : integer := 4;
         ADDRESS_LED_BRIGHTNESS : integer := 5;
         ADDRESS_SAMPLE_CLOCK_CONTROL : integer := 10;
+        ADDRESS_SAMPLE_MODE : integer := 16; -- bit2-0: encoding, bit3: burst, bit4: ddr, bit5: flush (write the last rle run before stopping)
+                                             -- rle loses runs shorter than two samples at divisor 0, counted in the telemetry flags
+        ADDRESS_TRIGGER_CONTROL : integer := 17;
+        ADDRESS_TRIGGER_PRETRIGGER : integer := 18;
+        ADDRESS_TRIGGER_POSITION : integer := 19; -- 4 bytes, lsb first (read only)
+        ADDRESS_TRIGGER_DROPPED : integer := 23; -- 2 bytes, lsb first (read only)
+        ADDRESS_TELEMETRY_CONTROL : integer := 25; -- write: take snapshot, read: flags of snapshot
+        ADDRESS_TELEMETRY_DROPPED : integer := 26; -- 4 bytes, lsb first (read only)
+        ADDRESS_TELEMETRY_HIGH_WATER : integer := 30; -- 2 bytes, lsb first (read only)
+        ADDRESS_TELEMETRY_WORDS : integer := 32; -- 4 bytes, lsb first (read only)
+        ADDRESS_TELEMETRY_SAMPLES : integer := 36; -- 4 bytes, lsb first (read only)
+        ADDRESS_SAMPLE_RATE_DIVISOR_MID : integer := 40; -- written to the divisor with ADDRESS_SAMPLE_RATE_DIVISOR
+        ADDRESS_SAMPLE_RATE_DIVISOR_HI : integer := 41; -- written to the divisor with ADDRESS_SAMPLE_RATE_DIVISOR
+        ADDRESS_SAMPLE_RATE_NUM : integer := 42; -- 2 bytes, lsb first
+        ADDRESS_SAMPLE_RATE_DEN : integer := 44; -- 2 bytes, lsb first
+        ADDRESS_BURST_DEPTH : integer := 46; -- block rams filled in burst mode (0: until the fifo is full)
+        ADDRESS_STATE_CONTROL : integer := 47; -- state mode: sample on edges of channel 15
+        ADDRESS_BITSTREAM_ID : integer := 48; -- 4 bytes (read only): io standard, then build hash lsb first
+        ADDRESS_GLITCH_WIDTH : integer := 52; -- 8 bytes, minimum pulse width in sample clocks, 4 bits per channel (channel 0 in the low nibble of the first byte)
+        ADDRESS_DECODER_UART_CONTROL : integer := 60; -- protocol decoder, see decoder.vhd
+        ADDRESS_DECODER_UART_BIT_PERIOD : integer := 61; -- 2 bytes, lsb first
+        ADDRESS_DECODER_SPI_CONTROL : integer := 63;
+        ADDRESS_DECODER_SPI_CHANNELS : integer := 64; -- 2 bytes: sclk, cs, mosi, miso (4 bits each, from the lsb)
+        ADDRESS_DECODER_I2C_CONTROL : integer := 66;
+        ADDRESS_DECODER_I2C_CHANNELS : integer := 67; -- scl, sda (4 bits each, from the lsb)
+        ADDRESS_STATS_CONTROL : integer := 68; -- write: bit0 hold the statistics, rewinds ADDRESS_STATS_DATA; read: bit7 results valid, bit0 hold
+        ADDRESS_STATS_GATE : integer := 69; -- 4 bytes, samples per gate (at least 33), lsb first
+        ADDRESS_STATS_DATA : integer := 74; -- read only: next byte of the statistics, see STATS_RESULT_BYTES
+        ADDRESS_PEAK_WINDOW : integer := 75; -- 2 bytes, lsb first: sample clocks per min/max pair (0 or 1: off, the rate divisor is ignored while on), see sample.vhd
+        ADDRESS_TRIGGER_MASK : integer := 96; -- 2 bytes per stage, lsb first
+        ADDRESS_TRIGGER_VALUE : integer := 104; -- 2 bytes per stage, lsb first
+        ADDRESS_TRIGGER_EDGE : integer := 112; -- 2 bytes per stage, lsb first
         
         FPGA_VERSION : integer := 16;
         
+        -- bitstream identity, set by the Makefile (0 when built otherwise)
+        BITSTREAM_IO : integer := 0; -- io standard of logic_data (18 or 33)
+        BITSTREAM_BUILD : integer := 0; -- 24 bit build hash (start of the git commit id)
+        
         -- other constants
         tick_1M_div : integer := 48 -- divider to get 1MHz from 48MHz clk
     );
@@ -67,6 +105,9 @@ end mainmodule;
 
 architecture behavioral of mainmodule is
 
+    constant BITSTREAM_ID : std_logic_vector(31 downto 0) :=
+        std_logic_vector(to_unsigned(BITSTREAM_BUILD, 24)) & std_logic_vector(to_unsigned(BITSTREAM_IO, 8));
+
     -- reset
     signal reset       : std_logic := '1';
     signal reset_count : unsigned(4 downto 0) := (others=>'1');
@@ -75,22 +116,17 @@ architecture behavioral of mainmodule is
     -- clock
     signal clk                : std_logic; -- 48MHz clock signal from the selected DCM
     signal clk_a, clk_b       : std_logic;
-    signal clk_c, clk_d       : std_logic;
     signal clk_100M           : std_logic; -- 100MHz clock from dcm1
     signal clk_100M_locked    : std_logic;
     signal clk_160M           : std_logic; -- 160MHz clock from dcm2
     signal clk_160M_locked    : std_logic;
-    signal clk_user           : std_logic; -- user clock
-    signal clk_user_2x        : std_logic; -- 2x user clock from dcm3
-    signal clk_user_2x_locked : std_logic;
-    signal clk_user_4x        : std_logic; -- 4x user clock from dcm4
-    signal clk_user_4x_locked : std_logic;
     signal tick_1M            : std_logic := '0';
     signal tick_1M_count      : unsigned(5 downto 0) := (others=>'0');
     
     -- internal data bus FIXME: spi
     signal spi_enable_write : std_logic;
     signal spi_enable_read  : std_logic;
+    signal spi_read_done    : std_logic;
     signal spi_addr         : std_logic_vector(6 downto 0);
     signal spi_data_out     : std_logic_vector(7 downto 0);
     signal spi_data_in      : std_logic_vector(7 downto 0);
@@ -100,24 +136,140 @@ architecture behavioral of mainmodule is
     signal led_invert          : std_logic;
     signal sample_run          : std_logic := '0'; -- set to '1' to sample data
     signal status_bit6         : std_logic;
-    signal sample_rate_divisor : std_logic_vector(7 downto 0); -- sample rate is base clock / (rate_divisor + 1)
-    signal sample_clk_sel      : unsigned(1 downto 0); -- 0: clk_100M, 1: clk_160M, 2: user 2x, 3: user 4x
+    signal sample_rate_divisor : std_logic_vector(23 downto 0); -- sample rate is base clock / (rate_divisor + 1 + rate_num / rate_den)
+    signal sample_rate_divisor_stage : std_logic_vector(23 downto 8); -- upper divisor bytes until the lowest one is written
+    signal sample_rate_num     : std_logic_vector(15 downto 0);
+    signal sample_rate_den     : std_logic_vector(15 downto 0);
+    signal sample_clk_sel      : unsigned(0 downto 0); -- 0: clk_100M, 1: clk_160M
     signal sample_clk          : std_logic; -- sample clock, 100 or 160MHz
     signal selected_channels   : std_logic_vector(15 downto 0);
+    signal sample_encoding     : unsigned(2 downto 0); -- format of the data written to the fifo, see ENCODING_*
+    signal sample_burst        : std_logic; -- stop writing to the fifo when burst_depth block rams are filled
+    signal sample_ddr          : std_logic; -- sample channels 0 to 7 on both edges of the sample clock
+    signal sample_flush        : std_logic; -- end the rle run in progress, cleared with sample_run
+    signal sample_flush_get    : std_logic; -- sample_flush sync'd to sample_clk
+    signal state_control       : std_logic_vector(7 downto 0); -- bit0: state mode, bit1: falling edge, bit2: qualify,
+                                                               -- bit3: qualifier level, bit7-4: qualifier channel
+    signal glitch_width        : std_logic_vector(63 downto 0); -- glitch filter, 4 bits per channel (0: off)
+    signal peak_window         : std_logic_vector(15 downto 0); -- peak detect decimation, sample clocks per window (0 or 1: off)
+    signal uart_control        : std_logic_vector(7 downto 0); -- protocol decoder configuration
+    signal uart_bit_period     : std_logic_vector(15 downto 0);
+    signal spi_control         : std_logic_vector(7 downto 0);
+    signal spi_channels        : std_logic_vector(15 downto 0);
+    signal i2c_control         : std_logic_vector(7 downto 0);
+    signal i2c_channels        : std_logic_vector(7 downto 0);
+    signal stats_gate_period   : std_logic_vector(31 downto 0); -- statistics gate in samples
+    
+    -- encodings of the data written to the fifo
+    constant ENCODING_BLOCKS : integer := 0; -- 16 samples per enabled channel and word (from the sample unit)
+    constant ENCODING_RLE    : integer := 1; -- (value, count) records from the rle unit
+    constant ENCODING_TRANSITIONS : integer := 2; -- (value, ticks) records from the transitions unit
+    constant ENCODING_SAMPLE_MAJOR : integer := 3; -- one byte per sample for up to 8 channels
+    constant ENCODING_TEST_PATTERN : integer := 4; -- 16 bit counter, one word per sample (throughput tests)
+    constant ENCODING_DECODED : integer := 5; -- timestamped bytes from the protocol decoder
+    constant ENCODING_STATISTICS : integer := 6; -- nothing, edges and high time are counted by the stats unit
+
+    -- samples passed from the sample unit to the encoders
+    signal sample_data   : std_logic_vector(15 downto 0);
+    signal sample_valid  : std_logic;
+    signal sample_active : std_logic;
+    signal block_data    : std_logic_vector(15 downto 0);
+    signal block_write   : std_logic;
+    signal rle_enable    : std_logic;
+    signal rle_data      : std_logic_vector(15 downto 0);
+    signal rle_write     : std_logic;
+    signal rle_overflow  : std_logic;
+    signal transitions_enable   : std_logic;
+    signal transitions_data     : std_logic_vector(15 downto 0);
+    signal transitions_write    : std_logic;
+    signal transitions_overflow : std_logic;
+    signal sample_major_enable  : std_logic;
+    signal sample_major_data    : std_logic_vector(15 downto 0);
+    signal sample_major_write   : std_logic;
+    signal pattern_enable       : std_logic;
+    signal pattern_count        : unsigned(15 downto 0) := (others=>'0');
+    signal pattern_data         : std_logic_vector(15 downto 0);
+    signal pattern_write        : std_logic := '0';
+    signal decoder_enable       : std_logic;
+    signal decoder_data         : std_logic_vector(15 downto 0);
+    signal decoder_write        : std_logic;
+    signal decoder_overflow     : std_logic;
+    signal stats_enable         : std_logic;
+    signal encoder_overflow     : std_logic;
+    signal encoder_write        : std_logic; -- fifo write of the selected encoder
+
+    -- burst mode
+    signal burst_depth     : unsigned(4 downto 0); -- block rams to fill, 0 for all
+    signal burst_last_word : unsigned(15 downto 0); -- last word to write, static while sampling
+    signal burst_words     : unsigned(15 downto 0); -- words written
+    signal burst_done      : std_logic := '0';
+
+    -- fifo size, uses all block rams
+    constant FIFO_RAM_COUNT_LOG2 : integer := 4;
+    constant FIFO_RAM_SIZE_LOG2  : integer := 10;
+
+    -- trigger
+    constant TRIGGER_STAGES_LOG2 : integer := 2;
+    signal trigger_enable     : std_logic; -- hold data until the trigger fired
+    signal trigger_last_stage : unsigned(TRIGGER_STAGES_LOG2-1 downto 0); -- number of used stages - 1
+    signal trigger_pretrigger : unsigned(FIFO_RAM_COUNT_LOG2-1 downto 0); -- number of fifo block rams kept before the trigger
+    signal trigger_mask       : std_logic_vector(16*2**TRIGGER_STAGES_LOG2-1 downto 0);
+    signal trigger_value      : std_logic_vector(16*2**TRIGGER_STAGES_LOG2-1 downto 0);
+    signal trigger_edge       : std_logic_vector(16*2**TRIGGER_STAGES_LOG2-1 downto 0);
+    signal trigger_hold       : std_logic;
+    signal trigger_fired      : std_logic;
+    signal trigger_fired_get  : std_logic; -- trigger_fired sync'd to clk
+    signal trigger_position   : unsigned(31 downto 0);
+
+    -- telemetry
+    signal telemetry_snapshot_set : std_logic := '0';
+    signal telemetry_snapshot_get : std_logic;
+    signal telemetry_flags        : std_logic_vector(7 downto 0);
+    signal telemetry_dropped      : unsigned(31 downto 0);
+    signal telemetry_high_water   : unsigned(15 downto 0);
+    signal telemetry_words        : unsigned(31 downto 0);
+    signal telemetry_samples      : unsigned(31 downto 0);
+
+    -- statistics, read from ADDRESS_STATS_DATA byte by byte: number of the
+    -- gate (4 bytes), then edges and high samples of channel 0 to 15 (4 bytes
+    -- each: 24 bit count, lsb first, and a byte with bit0 set when it
+    -- saturated)
+    constant STATS_RESULT_BYTES : integer := 4 + 16*8;
+    signal stats_hold_set : std_logic := '0';
+    signal stats_hold_get : std_logic;
+    signal stats_valid    : std_logic;
+    signal stats_valid_get : std_logic;
+    signal stats_gate     : unsigned(31 downto 0);
+    signal stats_result_addr : unsigned(4 downto 0);
+    signal stats_result   : std_logic_vector(24 downto 0);
+    signal stats_pointer  : unsigned(7 downto 0); -- next byte read from ADDRESS_STATS_DATA
 
     -- fifo to buffer logic data (from the core generator)
     signal fifo_reset        : std_logic;
-    signal fifo_almost_empty : std_logic;
+    signal fifo_out_empty    : std_logic;
     signal fifo_data_in      : std_logic_vector(15 downto 0);
     signal fifo_data_out     : std_logic_vector(15 downto 0);
     signal fifo_enable_read  : std_logic;
     signal fifo_enable_write : std_logic;
     signal fifo_full         : std_logic;
     signal fifo_almost_full  : std_logic;
+    signal fifo_dropped      : unsigned(15 downto 0);
+    signal fifo_level        : unsigned(15 downto 0);
+    signal bus_run           : std_logic; -- sample_run sync'd to fifo_clk
+    signal bus_clear         : std_logic;
+    signal bus_ready         : std_logic;
+    signal bus_read          : std_logic;
     
     -- debug
     signal debug : std_logic_vector(15 downto 0);
 
+    -- configuration used in the sample clock domain, static while sampling
+    attribute TIG : string;
+    attribute TIG of sample_encoding : signal is "TRUE";
+    attribute TIG of sample_burst : signal is "TRUE";
+    attribute TIG of burst_last_word : signal is "TRUE";
+    attribute TIG of stats_gate_period : signal is "TRUE";
+
 begin
 
     -- debug
@@ -156,44 +308,15 @@ begin
             clk_fast => clk_160M,
             locked   => clk_160M_locked
         );
---    clock_user1_inst : entity work.clock
---        generic map(
---            CLK_FAST_DIV => 1,
---            CLK_FAST_MUL => 2
---        )
---        port map(
---            clk_in   => clk_user,
---            reset    => reset_dcm,
---            clk      => clk_c,
---            clk_fb   => clk_c,
---            clk_fast => clk_user_2x,
---            locked   => clk_user_2x_locked
---        );
---    clock_user2_inst : entity work.clock
---        generic map(
---            CLK_FAST_DIV => 1,
---            CLK_FAST_MUL => 4
---        )
---        port map(
---            clk_in   => clk_user,
---            reset    => reset_dcm,
---            clk      => clk_d,
---            clk_fb   => clk_d,
---            clk_fast => clk_user_4x,
---            locked   => clk_user_4x_locked
---        );
-    clk_user <= logic_data(15);
     clockmux_inst : entity work.clockmux
         generic map(
-            n_log2 => 2
+            n_log2 => 1
         )
         port map(
             clk_ctl    => clk,
             clk_sel    => std_logic_vector(sample_clk_sel),
             clk_in(0)  => clk_100M,
             clk_in(1)  => clk_160M,
-            clk_in(2)  => '0',--clk_user_2x,
-            clk_in(3)  => '0',--clk_user_4x,
             clk_out    => sample_clk
         );
     clk <= clk_in; --FIXME: which clock to use for logic?
@@ -218,6 +341,7 @@ begin
             reset        => reset,
             enable_write => spi_enable_write,
             enable_read  => spi_enable_read,
+            read_done    => spi_read_done,
             addr         => spi_addr,
             data_out     => spi_data_out,
             data_in      => spi_data_in,
@@ -232,6 +356,10 @@ begin
     --   output is connected to the fx2
     --   input is connected to the sample unit
     fifo_inst : entity work.fifo
+        generic map(
+            ram_count_log2 => FIFO_RAM_COUNT_LOG2,
+            ram_size_log2  => FIFO_RAM_SIZE_LOG2
+        )
         port map(
             reset        => fifo_reset,
             clk_write    => sample_clk,
@@ -242,12 +370,35 @@ begin
             data_out     => fifo_data_out,
             full         => fifo_full,
             almost_full  => fifo_almost_full,
-            almost_empty => fifo_almost_empty
+            empty        => fifo_out_empty,
+            hold         => trigger_hold,
+            hold_limit   => trigger_pretrigger,
+            dropped      => fifo_dropped,
+            level        => fifo_level
+        );
+
+    -- read ahead buffer: lets the fx2 read one word per clock although it
+    -- sees fifo_empty a few clocks late
+    sync_bus_run_inst : entity work.syncsignal
+        port map(
+            clk_output => fifo_clk,
+            input      => sample_run,
+            output     => bus_run
+        );
+    bus_clear <= not bus_run;
+    readahead_inst : entity work.readahead
+        port map(
+            clk       => fifo_clk,
+            clear     => bus_clear,
+            src_data  => fifo_data_out,
+            src_empty => fifo_out_empty,
+            src_read  => fifo_enable_read,
+            data      => fifo_data,
+            read      => bus_read,
+            ready     => bus_ready
         );
-    -- for some reason the fx2 reads one word too much if empty is used
-    fifo_empty <= fifo_almost_empty or (not sample_run);
-    fifo_data <= fifo_data_out;
-    fifo_enable_read <= (not fifo_read_n);
+    bus_read <= not fifo_read_n;
+    fifo_empty <= (not bus_ready) or (not sample_run);
 
     -- sample logic inputs
     sample_inst : entity work.sample
@@ -255,14 +406,238 @@ begin
             sample_clk          => sample_clk,
             sample_run          => sample_run,
             sample_rate_divisor => sample_rate_divisor,
+            sample_rate_num     => sample_rate_num,
+            sample_rate_den     => sample_rate_den,
+            ddr                 => sample_ddr,
+            state_mode          => state_control(0),
+            state_falling       => state_control(1),
+            state_qualify       => state_control(2),
+            state_qualify_level => state_control(3),
+            state_qualify_chan  => unsigned(state_control(7 downto 4)),
+            glitch_width        => glitch_width,
+            peak_window         => peak_window,
             channel_select      => selected_channels,
             logic_data          => logic_data,
             --logic_data          => (others=>'0'),
-            fifo_data           => fifo_data_in,
+            fifo_data           => block_data,
             fifo_reset          => fifo_reset,
-            fifo_write          => fifo_enable_write,
+            fifo_write          => block_write,
             fifo_full           => fifo_full,
-            fifo_almost_full    => fifo_almost_full
+            fifo_almost_full    => fifo_almost_full,
+            sample_data         => sample_data,
+            sample_valid        => sample_valid,
+            sample_active       => sample_active
+        );
+
+    -- rle unit: collapses runs of unchanged samples
+    rle_inst : entity work.rle
+        port map(
+            clk        => sample_clk,
+            enable     => rle_enable,
+            flush      => sample_flush_get,
+            data_mask  => selected_channels,
+            data_in    => sample_data,
+            data_valid => sample_valid,
+            fifo_data  => rle_data,
+            fifo_write => rle_write,
+            overflow   => rle_overflow
+        );
+    rle_enable <= sample_active when (sample_encoding = ENCODING_RLE) else '0';
+    sync_sample_flush_inst : entity work.syncsignal
+        port map(
+            clk_output => sample_clk,
+            input      => sample_flush,
+            output     => sample_flush_get
+        );
+
+    -- transitions unit: timestamps changes of the input
+    transitions_inst : entity work.transitions
+        port map(
+            clk        => sample_clk,
+            enable     => transitions_enable,
+            data_mask  => selected_channels,
+            data_in    => sample_data,
+            data_valid => sample_valid,
+            fifo_data  => transitions_data,
+            fifo_write => transitions_write,
+            overflow   => transitions_overflow
+        );
+    transitions_enable <= sample_active when (sample_encoding = ENCODING_TRANSITIONS) else '0';
+
+    -- sample major unit: packs up to 8 channels into one byte per sample
+    sample_major_inst : entity work.sample_major
+        port map(
+            clk        => sample_clk,
+            enable     => sample_major_enable,
+            data_mask  => selected_channels,
+            data_in    => sample_data,
+            data_valid => sample_valid,
+            fifo_data  => sample_major_data,
+            fifo_write => sample_major_write
+        );
+    sample_major_enable <= sample_active when (sample_encoding = ENCODING_SAMPLE_MAJOR) else '0';
+
+    -- test pattern: a counter instead of the inputs, so the host can measure
+    -- the throughput and find lost words without any signals connected
+    process(sample_clk)
+    begin
+        if rising_edge(sample_clk) then
+            pattern_write <= '0';
+            if (sample_valid = '1') then
+                pattern_data <= std_logic_vector(pattern_count);
+                pattern_count <= pattern_count + 1;
+                pattern_write <= '1';
+            end if;
+            if (pattern_enable = '0') then
+                pattern_count <= (others=>'0');
+                pattern_write <= '0';
+            end if;
+        end if;
+    end process;
+    pattern_enable <= sample_active when (sample_encoding = ENCODING_TEST_PATTERN) else '0';
+
+    -- protocol decoder: uart, spi and i2c bytes instead of the samples
+    decoder_inst : entity work.decoder
+        port map(
+            clk             => sample_clk,
+            enable          => decoder_enable,
+            uart_control    => uart_control,
+            uart_bit_period => uart_bit_period,
+            spi_control     => spi_control,
+            spi_channels    => spi_channels,
+            i2c_control     => i2c_control,
+            i2c_channels    => i2c_channels,
+            data_in         => sample_data,
+            data_valid      => sample_valid,
+            fifo_data       => decoder_data,
+            fifo_write      => decoder_write,
+            overflow        => decoder_overflow
+        );
+    decoder_enable <= sample_active when (sample_encoding = ENCODING_DECODED) else '0';
+
+    -- statistics: edges and high time of each channel per gate, the fifo
+    -- stays empty. the results are held while they are read over spi
+    stats_inst : entity work.stats
+        port map(
+            clk         => sample_clk,
+            enable      => stats_enable,
+            gate_period => unsigned(stats_gate_period),
+            hold        => stats_hold_get,
+            data_in     => sample_data,
+            data_valid  => sample_valid,
+            valid       => stats_valid,
+            gate        => stats_gate,
+            result_addr => stats_result_addr,
+            result      => stats_result
+        );
+    stats_enable <= sample_active when (sample_encoding = ENCODING_STATISTICS) else '0';
+    sync_stats_hold_inst : entity work.syncsignal
+        port map(
+            clk_output => sample_clk,
+            input      => stats_hold_set,
+            output     => stats_hold_get
+        );
+    sync_stats_valid_inst : entity work.syncsignal
+        port map(
+            clk_output => clk,
+            input      => stats_valid,
+            output     => stats_valid_get
+        );
+    stats_result_addr <= resize(stats_pointer(7 downto 2) - 1, stats_result_addr'length);
+
+    -- trigger unit: holds the data in the fifo until the trigger condition is
+    -- seen, the last trigger_pretrigger block rams before are kept
+    trigger_inst : entity work.trigger
+        generic map(
+            stage_count_log2 => TRIGGER_STAGES_LOG2
+        )
+        port map(
+            clk        => sample_clk,
+            enable     => trigger_enable,
+            run        => sample_active,
+            last_stage => trigger_last_stage,
+            mask       => trigger_mask,
+            value      => trigger_value,
+            edge       => trigger_edge,
+            data_in    => sample_data,
+            data_valid => sample_valid,
+            hold       => trigger_hold,
+            fired      => trigger_fired,
+            position   => trigger_position
+        );
+    sync_trigger_fired_inst : entity work.syncsignal
+        port map(
+            clk_output => clk,
+            input      => trigger_fired,
+            output     => trigger_fired_get
+        );
+    
+    -- select the encoder which writes to the fifo
+    -- (sample_encoding must only be changed while sample_run is inactive)
+    fifo_data_in <= rle_data when (sample_encoding = ENCODING_RLE) else
+                    transitions_data when (sample_encoding = ENCODING_TRANSITIONS) else
+                    sample_major_data when (sample_encoding = ENCODING_SAMPLE_MAJOR) else
+                    pattern_data when (sample_encoding = ENCODING_TEST_PATTERN) else
+                    decoder_data when (sample_encoding = ENCODING_DECODED) else
+                    block_data;
+    encoder_write <= rle_write when (sample_encoding = ENCODING_RLE) else
+                     transitions_write when (sample_encoding = ENCODING_TRANSITIONS) else
+                     sample_major_write when (sample_encoding = ENCODING_SAMPLE_MAJOR) else
+                     pattern_write when (sample_encoding = ENCODING_TEST_PATTERN) else
+                     decoder_write when (sample_encoding = ENCODING_DECODED) else
+                     '0' when (sample_encoding = ENCODING_STATISTICS) else
+                     block_write;
+    fifo_enable_write <= encoder_write and not burst_done;
+
+    -- burst mode: stop writing when the selected number of block rams is
+    -- filled or the fifo gets full, so the fifo holds a capture without gaps
+    -- at any sample rate which is then drained by the fx2
+    burst_last_word <= shift_left(resize(burst_depth, 16), FIFO_RAM_SIZE_LOG2) - 1;
+    process(sample_clk)
+    begin
+        if rising_edge(sample_clk) then
+            if (encoder_write = '1') and (burst_done = '0') then
+                if (fifo_full = '1') then
+                    -- lost this word, it is the first one after the capture
+                    burst_done <= '1';
+                else
+                    burst_words <= burst_words + 1;
+                    if (burst_depth /= 0) and (burst_words = burst_last_word) then
+                        burst_done <= '1';
+                    end if;
+                end if;
+            end if;
+            if (sample_burst = '0') or (sample_active = '0') then
+                burst_words <= (others=>'0');
+                burst_done <= '0';
+            end if;
+        end if;
+    end process;
+    encoder_overflow <= rle_overflow or transitions_overflow or decoder_overflow;
+
+    -- telemetry unit: counts lost data etc. to find the sustainable sample rate
+    telemetry_inst : entity work.telemetry
+        port map(
+            clk              => sample_clk,
+            run              => sample_active,
+            snapshot         => telemetry_snapshot_get,
+            sample_valid     => sample_valid,
+            fifo_write       => fifo_enable_write,
+            fifo_full        => fifo_full,
+            fifo_level       => fifo_level,
+            encoder_overflow => encoder_overflow,
+            flags            => telemetry_flags,
+            dropped          => telemetry_dropped,
+            high_water       => telemetry_high_water,
+            words            => telemetry_words,
+            samples          => telemetry_samples
+        );
+    flag_telemetry_snapshot_inst : entity work.syncflag
+        port map(
+            clk_input  => clk,
+            clk_output => sample_clk,
+            input      => telemetry_snapshot_set,
+            output     => telemetry_snapshot_get
         );
 
     -- create internal reset signal from 48MHz input clock
@@ -306,6 +681,7 @@ begin
             if (reset = '1') then
                 sample_clk_sel <= (others=>'0');
                 spi_data_in <= (others=>'0');
+                telemetry_snapshot_set <= '0';
                 -- init status/control
                 led_brightness <= (others=>'0');
                 led_invert <= '0';
@@ -313,9 +689,36 @@ begin
                 status_bit6 <= '0';
                 selected_channels <= (others=>'1');
                 sample_rate_divisor <= (others=>'0');
+                sample_rate_divisor_stage <= (others=>'0');
+                sample_rate_num <= (others=>'0');
+                sample_rate_den <= (others=>'0');
+                sample_encoding <= (others=>'0');
+                sample_burst <= '0';
+                sample_ddr <= '0';
+                sample_flush <= '0';
+                state_control <= (others=>'0');
+                glitch_width <= (others=>'0');
+                peak_window <= (others=>'0');
+                uart_control <= (others=>'0');
+                uart_bit_period <= (others=>'0');
+                spi_control <= (others=>'0');
+                spi_channels <= (others=>'0');
+                i2c_control <= (others=>'0');
+                i2c_channels <= (others=>'0');
+                stats_gate_period <= (others=>'0');
+                stats_hold_set <= '0';
+                stats_pointer <= (others=>'0');
+                burst_depth <= (others=>'0');
+                trigger_enable <= '0';
+                trigger_last_stage <= (others=>'0');
+                trigger_pretrigger <= (others=>'0');
+                trigger_mask <= (others=>'0');
+                trigger_value <= (others=>'0');
+                trigger_edge <= (others=>'0');
             else
                 -- handle spi
                 spi_data_in <= (others=>'0');
+                telemetry_snapshot_set <= '0';
                 if (spi_enable_read = '1') then
                     if (unsigned(spi_addr) = ADDRESS_FPGA_VERSION) then
                         spi_data_in <= std_logic_vector(to_unsigned(FPGA_VERSION, spi_data_in'length));
@@ -326,11 +729,136 @@ begin
                     elsif (unsigned(spi_addr) = ADDRESS_CHANNEL_SELECT_HI) then
                         spi_data_in <= selected_channels(15 downto 8);
                     elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_RATE_DIVISOR) then
-                        spi_data_in <= sample_rate_divisor;
+                        spi_data_in <= sample_rate_divisor(7 downto 0);
+                    elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_RATE_DIVISOR_MID) then
+                        spi_data_in <= sample_rate_divisor(15 downto 8);
+                    elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_RATE_DIVISOR_HI) then
+                        spi_data_in <= sample_rate_divisor(23 downto 16);
                     elsif (unsigned(spi_addr) = ADDRESS_LED_BRIGHTNESS) then
                         spi_data_in <= led_brightness;
                     elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_CLOCK_CONTROL) then
                         spi_data_in <= "0000000" & sample_clk_sel(0);
+                    elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_MODE) then
+                        spi_data_in <= "00" & sample_flush & sample_ddr & sample_burst & std_logic_vector(sample_encoding);
+                    elsif (unsigned(spi_addr) = ADDRESS_TRIGGER_CONTROL) then
+                        spi_data_in <= trigger_fired_get & "0000" & std_logic_vector(trigger_last_stage) & trigger_enable;
+                    elsif (unsigned(spi_addr) = ADDRESS_TRIGGER_PRETRIGGER) then
+                        spi_data_in <= std_logic_vector(resize(trigger_pretrigger, 8));
+                    elsif (unsigned(spi_addr) = ADDRESS_BURST_DEPTH) then
+                        spi_data_in <= std_logic_vector(resize(burst_depth, 8));
+                    elsif (unsigned(spi_addr) = ADDRESS_STATE_CONTROL) then
+                        spi_data_in <= state_control;
+                    elsif (unsigned(spi_addr) = ADDRESS_TELEMETRY_CONTROL) then
+                        spi_data_in <= telemetry_flags;
+                    elsif (unsigned(spi_addr) = ADDRESS_DECODER_UART_CONTROL) then
+                        spi_data_in <= uart_control;
+                    elsif (unsigned(spi_addr) = ADDRESS_DECODER_SPI_CONTROL) then
+                        spi_data_in <= spi_control;
+                    elsif (unsigned(spi_addr) = ADDRESS_DECODER_I2C_CONTROL) then
+                        spi_data_in <= i2c_control;
+                    elsif (unsigned(spi_addr) = ADDRESS_DECODER_I2C_CHANNELS) then
+                        spi_data_in <= i2c_channels;
+                    elsif (unsigned(spi_addr) = ADDRESS_STATS_CONTROL) then
+                        spi_data_in <= stats_valid_get & "000000" & stats_hold_set;
+                    elsif (unsigned(spi_addr) = ADDRESS_STATS_DATA) then
+                        -- one byte of the results per read, the pointer
+                        -- moves when it was sent (see spi_read_done below)
+                        if (stats_pointer < 4) then
+                            for i in 0 to 3 loop
+                                if (stats_pointer(1 downto 0) = i) then
+                                    spi_data_in <= std_logic_vector(stats_gate(8*i+7 downto 8*i));
+                                end if;
+                            end loop;
+                        elsif (stats_pointer = STATS_RESULT_BYTES) then
+                            spi_data_in <= (others=>'0');
+                        else
+                            -- counter (stats_result_addr) bytes 0 to 2, then the flags
+                            spi_data_in <= "0000000" & stats_result(24);
+                            for i in 0 to 2 loop
+                                if (stats_pointer(1 downto 0) = i) then
+                                    spi_data_in <= stats_result(8*i+7 downto 8*i);
+                                end if;
+                            end loop;
+                        end if;
+                    end if;
+                    for i in 0 to 3 loop
+                        if (unsigned(spi_addr) = ADDRESS_BITSTREAM_ID + i) then
+                            spi_data_in <= BITSTREAM_ID(8*i+7 downto 8*i);
+                        end if;
+                    end loop;
+                    -- trigger results (stable while sample_run is inactive)
+                    for i in 0 to 3 loop
+                        if (unsigned(spi_addr) = ADDRESS_TRIGGER_POSITION + i) then
+                            spi_data_in <= std_logic_vector(trigger_position(8*i+7 downto 8*i));
+                        end if;
+                    end loop;
+                    for i in 0 to 1 loop
+                        if (unsigned(spi_addr) = ADDRESS_TRIGGER_DROPPED + i) then
+                            spi_data_in <= std_logic_vector(fifo_dropped(8*i+7 downto 8*i));
+                        end if;
+                    end loop;
+                    -- telemetry snapshot
+                    for i in 0 to 3 loop
+                        if (unsigned(spi_addr) = ADDRESS_TELEMETRY_DROPPED + i) then
+                            spi_data_in <= std_logic_vector(telemetry_dropped(8*i+7 downto 8*i));
+                        elsif (unsigned(spi_addr) = ADDRESS_TELEMETRY_WORDS + i) then
+                            spi_data_in <= std_logic_vector(telemetry_words(8*i+7 downto 8*i));
+                        elsif (unsigned(spi_addr) = ADDRESS_TELEMETRY_SAMPLES + i) then
+                            spi_data_in <= std_logic_vector(telemetry_samples(8*i+7 downto 8*i));
+                        end if;
+                    end loop;
+                    for i in 0 to 1 loop
+                        if (unsigned(spi_addr) = ADDRESS_TELEMETRY_HIGH_WATER + i) then
+                            spi_data_in <= std_logic_vector(telemetry_high_water(8*i+7 downto 8*i));
+                        end if;
+                    end loop;
+                    -- fractional divisor
+                    for i in 0 to 1 loop
+                        if (unsigned(spi_addr) = ADDRESS_SAMPLE_RATE_NUM + i) then
+                            spi_data_in <= sample_rate_num(8*i+7 downto 8*i);
+                        elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_RATE_DEN + i) then
+                            spi_data_in <= sample_rate_den(8*i+7 downto 8*i);
+                        end if;
+                    end loop;
+                    for i in 0 to 7 loop
+                        if (unsigned(spi_addr) = ADDRESS_GLITCH_WIDTH + i) then
+                            spi_data_in <= glitch_width(8*i+7 downto 8*i);
+                        end if;
+                    end loop;
+                    for i in 0 to 1 loop
+                        if (unsigned(spi_addr) = ADDRESS_DECODER_UART_BIT_PERIOD + i) then
+                            spi_data_in <= uart_bit_period(8*i+7 downto 8*i);
+                        elsif (unsigned(spi_addr) = ADDRESS_DECODER_SPI_CHANNELS + i) then
+                            spi_data_in <= spi_channels(8*i+7 downto 8*i);
+                        end if;
+                    end loop;
+                    for i in 0 to 3 loop
+                        if (unsigned(spi_addr) = ADDRESS_STATS_GATE + i) then
+                            spi_data_in <= stats_gate_period(8*i+7 downto 8*i);
+                        end if;
+                    end loop;
+                    for i in 0 to 1 loop
+                        if (unsigned(spi_addr) = ADDRESS_PEAK_WINDOW + i) then
+                            spi_data_in <= peak_window(8*i+7 downto 8*i);
+                        end if;
+                    end loop;
+                    -- trigger stages
+                    for i in 0 to 2*2**TRIGGER_STAGES_LOG2-1 loop
+                        if (unsigned(spi_addr) = ADDRESS_TRIGGER_MASK + i) then
+                            spi_data_in <= trigger_mask(8*i+7 downto 8*i);
+                        elsif (unsigned(spi_addr) = ADDRESS_TRIGGER_VALUE + i) then
+                            spi_data_in <= trigger_value(8*i+7 downto 8*i);
+                        elsif (unsigned(spi_addr) = ADDRESS_TRIGGER_EDGE + i) then
+                            spi_data_in <= trigger_edge(8*i+7 downto 8*i);
+                        end if;
+                    end loop;
+                end if;
+                -- registers with a side effect on reading: a burst loads
+                -- the register after its last byte too, so only act when
+                -- the byte was sent
+                if (spi_read_done = '1') then
+                    if (unsigned(spi_addr) = ADDRESS_STATS_DATA) and (stats_pointer /= STATS_RESULT_BYTES) then
+                        stats_pointer <= stats_pointer + 1;
                     end if;
                 end if;
                 if (spi_enable_write = '1') then
@@ -338,19 +866,92 @@ begin
                         sample_run <= spi_data_out(0);
                         status_bit6 <= spi_data_out(6);
                         led_invert <= spi_data_out(0);
+                        if (spi_data_out(0) = '0') then
+                            sample_flush <= '0';
+                        end if;
                     elsif (unsigned(spi_addr) = ADDRESS_CHANNEL_SELECT_LO) then
                         selected_channels(7 downto 0) <= spi_data_out;
                     elsif (unsigned(spi_addr) = ADDRESS_CHANNEL_SELECT_HI) then
                         selected_channels(15 downto 8) <= spi_data_out;
                     elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_RATE_DIVISOR) then
-                        sample_rate_divisor <= spi_data_out;
+                        -- latch the whole divisor at once, the upper bytes
+                        -- are cleared so a plain 8 bit write works as before
+                        sample_rate_divisor <= sample_rate_divisor_stage & spi_data_out;
+                        sample_rate_divisor_stage <= (others=>'0');
+                    elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_RATE_DIVISOR_MID) then
+                        sample_rate_divisor_stage(15 downto 8) <= spi_data_out;
+                    elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_RATE_DIVISOR_HI) then
+                        sample_rate_divisor_stage(23 downto 16) <= spi_data_out;
                     elsif (unsigned(spi_addr) = ADDRESS_LED_BRIGHTNESS) then
                         led_brightness <= spi_data_out;
                     elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_CLOCK_CONTROL) then
                         sample_clk_sel(0) <= spi_data_out(0);
-                    elsif (unsigned(spi_addr) = 123) then--foo
-                        sample_clk_sel(1) <= spi_data_out(0);--bogus
+                    elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_MODE) then
+                        sample_encoding <= unsigned(spi_data_out(2 downto 0));
+                        sample_burst <= spi_data_out(3);
+                        sample_ddr <= spi_data_out(4);
+                        sample_flush <= spi_data_out(5);
+                    elsif (unsigned(spi_addr) = ADDRESS_TRIGGER_CONTROL) then
+                        trigger_enable <= spi_data_out(0);
+                        trigger_last_stage <= unsigned(spi_data_out(TRIGGER_STAGES_LOG2 downto 1));
+                    elsif (unsigned(spi_addr) = ADDRESS_TRIGGER_PRETRIGGER) then
+                        trigger_pretrigger <= unsigned(spi_data_out(FIFO_RAM_COUNT_LOG2-1 downto 0));
+                    elsif (unsigned(spi_addr) = ADDRESS_BURST_DEPTH) then
+                        burst_depth <= unsigned(spi_data_out(4 downto 0));
+                    elsif (unsigned(spi_addr) = ADDRESS_STATE_CONTROL) then
+                        state_control <= spi_data_out;
+                    elsif (unsigned(spi_addr) = ADDRESS_TELEMETRY_CONTROL) then
+                        telemetry_snapshot_set <= '1';
+                    elsif (unsigned(spi_addr) = ADDRESS_DECODER_UART_CONTROL) then
+                        uart_control <= spi_data_out;
+                    elsif (unsigned(spi_addr) = ADDRESS_DECODER_SPI_CONTROL) then
+                        spi_control <= spi_data_out;
+                    elsif (unsigned(spi_addr) = ADDRESS_DECODER_I2C_CONTROL) then
+                        i2c_control <= spi_data_out;
+                    elsif (unsigned(spi_addr) = ADDRESS_DECODER_I2C_CHANNELS) then
+                        i2c_channels <= spi_data_out;
+                    elsif (unsigned(spi_addr) = ADDRESS_STATS_CONTROL) then
+                        stats_hold_set <= spi_data_out(0);
+                        stats_pointer <= (others=>'0');
                     end if;
+                    for i in 0 to 1 loop
+                        if (unsigned(spi_addr) = ADDRESS_SAMPLE_RATE_NUM + i) then
+                            sample_rate_num(8*i+7 downto 8*i) <= spi_data_out;
+                        elsif (unsigned(spi_addr) = ADDRESS_SAMPLE_RATE_DEN + i) then
+                            sample_rate_den(8*i+7 downto 8*i) <= spi_data_out;
+                        end if;
+                    end loop;
+                    for i in 0 to 7 loop
+                        if (unsigned(spi_addr) = ADDRESS_GLITCH_WIDTH + i) then
+                            glitch_width(8*i+7 downto 8*i) <= spi_data_out;
+                        end if;
+                    end loop;
+                    for i in 0 to 1 loop
+                        if (unsigned(spi_addr) = ADDRESS_DECODER_UART_BIT_PERIOD + i) then
+                            uart_bit_period(8*i+7 downto 8*i) <= spi_data_out;
+                        elsif (unsigned(spi_addr) = ADDRESS_DECODER_SPI_CHANNELS + i) then
+                            spi_channels(8*i+7 downto 8*i) <= spi_data_out;
+                        end if;
+                    end loop;
+                    for i in 0 to 3 loop
+                        if (unsigned(spi_addr) = ADDRESS_STATS_GATE + i) then
+                            stats_gate_period(8*i+7 downto 8*i) <= spi_data_out;
+                        end if;
+                    end loop;
+                    for i in 0 to 1 loop
+                        if (unsigned(spi_addr) = ADDRESS_PEAK_WINDOW + i) then
+                            peak_window(8*i+7 downto 8*i) <= spi_data_out;
+                        end if;
+                    end loop;
+                    for i in 0 to 2*2**TRIGGER_STAGES_LOG2-1 loop
+                        if (unsigned(spi_addr) = ADDRESS_TRIGGER_MASK + i) then
+                            trigger_mask(8*i+7 downto 8*i) <= spi_data_out;
+                        elsif (unsigned(spi_addr) = ADDRESS_TRIGGER_VALUE + i) then
+                            trigger_value(8*i+7 downto 8*i) <= spi_data_out;
+                        elsif (unsigned(spi_addr) = ADDRESS_TRIGGER_EDGE + i) then
+                            trigger_edge(8*i+7 downto 8*i) <= spi_data_out;
+                        end if;
+                    end loop;
                 end if;
             end if;
         end if;
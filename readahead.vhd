@@ -0,0 +1,148 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- small read ahead buffer between the fifo and the fx2 bus, so the fx2 can
+-- read one word per clock
+--
+-- the fx2 sees ready with a few clocks latency and keeps reading for that
+-- long after ready went low. ready is only set while the buffer holds more
+-- words than ready was set in the last "window" clocks, so each of these
+-- reads finds a word no matter when it arrives (window must be longer than
+-- the round trip from ready to read). the buffer is filled from the fifo
+-- whenever it has data, which also hides the gaps of the fifo between its
+-- block rams
+--
+-- data comes from a register (packed into the iob), it is loaded with the
+-- word at the read pointer of the next clock, or with src_data when that word
+-- is written on this clock, so the pad timing doesn't include the lut ram
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity readahead is
+    generic(
+        size_log2 : integer := 4; -- buffer size
+        window    : integer := 8 -- clocks a read may arrive after ready
+    );
+    port(
+        clk       : in std_logic; -- fx2 bus clock
+        clear     : in std_logic; -- empty the buffer
+        src_data  : in std_logic_vector(15 downto 0); -- fifo data_out
+        src_empty : in std_logic; -- fifo empty flag
+        src_read  : out std_logic; -- fifo enable_read
+        data      : out std_logic_vector(15 downto 0); -- oldest word
+        read      : in std_logic; -- data is read on this clock
+        ready     : out std_logic := '0' -- words can be read, see above
+    );
+end readahead;
+
+
+architecture behavioral of readahead is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+    type mem_t is array (0 to 2**size_log2-1) of vector16_t;
+
+    signal mem       : mem_t;
+    signal read_ptr  : unsigned(size_log2-1 downto 0) := (others=>'0');
+    signal write_ptr : unsigned(size_log2-1 downto 0) := (others=>'0');
+    signal level     : unsigned(size_log2 downto 0) := (others=>'0');
+    signal fill      : std_logic;
+    signal take      : std_logic;
+    signal ready_int : std_logic := '0';
+    signal ready_history : std_logic_vector(window-2 downto 0) := (others=>'0'); -- ready of the previous clocks
+    signal data_reg  : std_logic_vector(15 downto 0) := (others=>'0'); -- mem(read_ptr)
+
+    attribute IOB : string;
+    attribute IOB of data_reg : signal is "TRUE";
+
+begin
+
+    fill <= '1' when (src_empty = '0') and (level < 2**size_log2) else '0';
+    take <= '1' when (read = '1') and (level /= 0) else '0';
+    src_read <= fill;
+    data <= data_reg;
+    ready <= ready_int;
+
+    process(clk)
+        variable pending : integer range 0 to window;
+        variable avail : unsigned(size_log2 downto 0);
+        variable next_ptr : unsigned(size_log2-1 downto 0);
+    begin
+        if rising_edge(clk) then
+            if (fill = '1') then
+                mem(to_integer(write_ptr)) <= src_data;
+                write_ptr <= write_ptr + 1;
+            end if;
+            next_ptr := read_ptr;
+            if (take = '1') then
+                next_ptr := read_ptr + 1;
+            end if;
+            read_ptr <= next_ptr;
+            if (fill = '1') and (write_ptr = next_ptr) then
+                data_reg <= src_data;
+            else
+                data_reg <= mem(to_integer(next_ptr));
+            end if;
+            if (fill = '1') and (take = '0') then
+                level <= level + 1;
+            elsif (fill = '0') and (take = '1') then
+                level <= level - 1;
+            end if;
+
+            -- reads which may still arrive: ready of this and the previous
+            -- clocks (a read arriving now is counted twice, that's safe)
+            pending := 0;
+            if (ready_int = '1') then
+                pending := 1;
+            end if;
+            for i in ready_history'range loop
+                if (ready_history(i) = '1') then
+                    pending := pending + 1;
+                end if;
+            end loop;
+            ready_history <= ready_history(ready_history'high-1 downto 0) & ready_int;
+            -- words left after this clock, not counting the one filled now
+            avail := level;
+            if (take = '1') then
+                avail := level - 1;
+            end if;
+            if (avail > pending) then
+                ready_int <= '1';
+            else
+                ready_int <= '0';
+            end if;
+
+            if (clear = '1') then
+                read_ptr <= (others=>'0');
+                write_ptr <= (others=>'0');
+                level <= (others=>'0');
+                ready_int <= '0';
+                ready_history <= (others=>'0');
+            end if;
+        end if;
+    end process;
+
+end behavioral;
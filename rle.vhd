@@ -0,0 +1,137 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- run length encoder for the sampled input words
+--
+-- runs of unchanged input words are collapsed into records of two fifo words:
+-- first the value of the run, then the run length - 1 (so a record covers
+-- 1 to 65536 samples, longer runs are split into multiple records)
+--
+-- a record is written when its run ends. the last run of a capture is ended
+-- by flush, which is set before sampling stops (the fifo is cleared when
+-- enable drops, so a record written then would be lost). samples are ignored
+-- while flush is set
+--
+-- writing a record takes two clocks and one finished run can be held while
+-- the previous one is written. if runs end faster than that (runs shorter
+-- than two samples at the undivided sample clock) records are lost and
+-- overflow is strobed
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity rle is
+    port(
+        clk        : in std_logic; -- sample clock
+        enable     : in std_logic; -- '1' to encode, '0' to reset
+        flush      : in std_logic := '0'; -- end the current run and write it, ignore samples (sync'd to clk)
+        data_mask  : in std_logic_vector(15 downto 0); -- unselected channels are read as '0', async (must only be changed while enable is inactive)
+        data_in    : in std_logic_vector(15 downto 0); -- sampled input word
+        data_valid : in std_logic; -- data_in holds a new sample
+        fifo_data  : out std_logic_vector(15 downto 0) := (others=>'0'); -- data to fifo
+        fifo_write : out std_logic := '0'; -- tell fifo to write data on next clock
+        overflow   : out std_logic := '0' -- strobed when a record was lost
+    );
+end rle;
+
+
+architecture behavioral of rle is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+
+    signal run_value   : vector16_t; -- value of the current run
+    signal run_count   : unsigned(15 downto 0); -- length of the current run - 1
+    signal run_valid   : std_logic := '0'; -- a run has been started
+    signal hold_value  : vector16_t; -- finished run waiting to be written
+    signal hold_count  : unsigned(15 downto 0);
+    signal hold_valid  : std_logic := '0';
+    signal write_count : std_logic := '0'; -- value was written, count is written next
+
+    attribute TIG : string;
+    attribute TIG of data_mask : signal is "TRUE";
+
+begin
+
+    process(clk)
+        variable value : vector16_t;
+    begin
+        if rising_edge(clk) then
+            fifo_write <= '0';
+            overflow <= '0';
+
+            -- write held record to fifo, value first then count
+            if (write_count = '1') then
+                fifo_data <= std_logic_vector(hold_count);
+                fifo_write <= '1';
+                write_count <= '0';
+                hold_valid <= '0';
+            elsif (hold_valid = '1') then
+                fifo_data <= hold_value;
+                fifo_write <= '1';
+                write_count <= '1';
+            end if;
+
+            -- end the current run once the hold is free
+            if (flush = '1') then
+                if (run_valid = '1') and ((hold_valid = '0') or (write_count = '1')) then
+                    hold_value <= run_value;
+                    hold_count <= run_count;
+                    hold_valid <= '1';
+                    run_valid <= '0';
+                end if;
+            -- extend current run or start a new one
+            elsif (data_valid = '1') then
+                value := data_in and data_mask;
+                if (run_valid = '1') and (value = run_value) and (run_count /= 2**run_count'length-1) then
+                    run_count <= run_count + 1;
+                else
+                    if (run_valid = '1') then
+                        if (hold_valid = '0') or (write_count = '1') then
+                            -- hold is free or freed with this clock
+                            hold_value <= run_value;
+                            hold_count <= run_count;
+                            hold_valid <= '1';
+                        else
+                            overflow <= '1';
+                        end if;
+                    end if;
+                    run_value <= value;
+                    run_count <= (others=>'0');
+                    run_valid <= '1';
+                end if;
+            end if;
+
+            -- reset
+            if (enable = '0') then
+                run_valid <= '0';
+                hold_valid <= '0';
+                write_count <= '0';
+                fifo_write <= '0';
+            end if;
+        end if;
+    end process;
+
+end behavioral;
@@ -22,25 +22,65 @@
 -- samples the logic inputs and converts the data into blocks of 16 samples per
 -- enabled channel
 --
+-- in ddr mode channels 0 to 7 are sampled on both edges of the sample clock and
+-- each block holds 16 samples taken at twice the sample clock rate (the sample
+-- rate divisor is ignored, only channel_select(7 downto 0) is used). both edges
+-- are captured by IDDR2 in the input blocks, so the skew between them doesn't
+-- depend on routing, and the falling edge sample is passed to the rising edge
+-- in the iob (DDR_ALIGNMENT "C0")
+--
+-- in state mode a sample is taken on each rising or falling edge of channel 15
+-- (the external clock), optionally only while a qualifier channel has a given
+-- level. the inputs are oversampled with the sample clock, the sample taken is
+-- the one just before the edge was seen, so the external clock must stay high
+-- and low for at least 2 sample clocks each (up to 25MHz at 100MHz)
+--
+-- in timing mode the inputs pass the glitch filter before they are sampled,
+-- pulses shorter than the channel's glitch_width (in sample clocks, not
+-- samples) are removed. ddr and state mode are not filtered
+--
+-- with a peak_window of n >= 2 (timing mode only) the inputs are taken on
+-- every sample clock and not passed on, instead two samples are made from each
+-- window of n clocks: the minimum (and) and then the maximum (or) of each
+-- channel. a channel was low (0, 0), high (1, 1) or toggled (0, 1) in the
+-- window, so pulses shorter than the window still show up in a decimated
+-- capture. the sample rate divisor is ignored, the rate is 2 * clock / n
+--
 ----------------------------------------------------------------------------------
 
 library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
 
+library unisim;
+use unisim.vcomponents.all;
+
 
 entity sample is
     port(
         sample_clk          : in std_logic; -- sample clock, 100 or 160MHz
         sample_run          : in std_logic; -- set to '1' to sample, '0' to reset
-        sample_rate_divisor : in std_logic_vector(7 downto 0); -- sample rate = clock / (div + 1)
+        sample_rate_divisor : in std_logic_vector(23 downto 0); -- sample rate = clock / (div + 1 + num / den)
+        sample_rate_num     : in std_logic_vector(15 downto 0) := (others=>'0'); -- fractional part of the divisor, must be < den (0 to disable, ignored for div = 0)
+        sample_rate_den     : in std_logic_vector(15 downto 0) := (others=>'0');
+        ddr                 : in std_logic := '0'; -- sample channels 0 to 7 on both clock edges, async (must only be changed while sample_run is inactive)
+        state_mode          : in std_logic := '0'; -- sample on edges of channel 15, async (must only be changed while sample_run is inactive)
+        state_falling       : in std_logic := '0'; -- '1' to sample on falling edges of channel 15
+        state_qualify       : in std_logic := '0'; -- '1' to only sample while the qualifier channel is at state_qualify_level
+        state_qualify_level : in std_logic := '1';
+        state_qualify_chan  : in unsigned(3 downto 0) := (others=>'0'); -- qualifier channel
+        glitch_width        : in std_logic_vector(63 downto 0) := (others=>'0'); -- minimum pulse width per channel in sample clocks, 4 bits each (0: off), async (must only be changed while sample_run is inactive)
+        peak_window         : in std_logic_vector(15 downto 0) := (others=>'0'); -- sample clocks per min/max pair (0 or 1: off), async (same)
         logic_data          : in std_logic_vector(15 downto 0); -- input pins
         channel_select      : in std_logic_vector(15 downto 0); -- channel select bits, async (must only be changed while sample_tick is inactive)
         fifo_data           : out std_logic_vector(15 downto 0) := (others=>'0'); -- data to fifo
         fifo_reset          : out std_logic := '0'; -- reset/clear fifo (sync'd to sample clock)
         fifo_write          : out std_logic; -- tell fifo to write data on next clock
         fifo_full           : in std_logic;
-        fifo_almost_full    : in std_logic
+        fifo_almost_full    : in std_logic;
+        sample_data         : out std_logic_vector(15 downto 0); -- sampled input word for the encoders
+        sample_valid        : out std_logic := '0'; -- sample_data holds a new sample (at the divided sample rate)
+        sample_active       : out std_logic := '0' -- sampling is running and the fifo is ready
     );
 end sample;
 
@@ -56,10 +96,38 @@ architecture behavioral of sample is
     type vector16_arr_t is array (natural range <>) of vector16_t;
 
     signal sample_run_get            : std_logic; -- sample_run signal accross clock domains
-    signal sample_tick_count         : unsigned(7 downto 0); -- used to divide sample clock
+    signal sample_tick_count         : unsigned(23 downto 0); -- used to divide sample clock
+    signal frac_enable               : std_logic; -- use the fractional part of the divisor
+    signal frac_num_minus_den        : signed(17 downto 0);
+    signal frac_acc                  : unsigned(15 downto 0); -- fractional accumulator, always < den
+    signal frac_sum                  : unsigned(16 downto 0); -- acc + num (register'd)
+    signal frac_diff                 : signed(17 downto 0); -- acc + num - den (register'd)
+    signal frac_stall                : std_logic; -- add one clock to the current sample period
     signal sample_tick               : std_logic; -- flag when sample_tick_count reached zero
     signal sample_count              : unsigned(4 downto 0); -- count samples
     signal logic_data_reg            : std_logic_vector(15 downto 0); -- "register" input
+    signal logic_data_reg_2          : std_logic_vector(15 downto 0); -- sample after logic_data_reg in ddr mode
+    signal sample_clk_n              : std_logic;
+    signal logic_data_iddr           : std_logic_vector(7 downto 0); -- ddr input taken at the rising edge (IDDR2 Q0)
+    signal logic_data_fall           : std_logic_vector(7 downto 0); -- ddr input taken at the falling edge after it (IDDR2 Q1)
+    signal logic_data_rise           : std_logic_vector(7 downto 0); -- logic_data_iddr delayed to pair with logic_data_fall
+    signal filtered_data             : std_logic_vector(15 downto 0); -- logic_data_reg after the glitch filter
+    signal input_data                : std_logic_vector(15 downto 0); -- to the input shiftregs and the encoders
+    signal peak_enable               : std_logic; -- min/max of each peak_window samples instead of the samples
+    signal peak_left                 : unsigned(15 downto 0); -- clocks left in the window - 1
+    signal peak_min                  : std_logic_vector(15 downto 0); -- and of the samples in the window so far
+    signal peak_max                  : std_logic_vector(15 downto 0); -- or of the samples in the window so far
+    signal peak_max_out              : std_logic_vector(15 downto 0); -- max of the last window
+    signal peak_max_pending          : std_logic := '0'; -- peak_max_out follows the min
+    signal peak_tick                 : std_logic := '0';
+    signal peak_data                 : std_logic_vector(15 downto 0);
+    signal take_tick                 : std_logic; -- sample_tick or peak_tick
+    signal take_data                 : std_logic_vector(15 downto 0); -- input_data or peak_data
+    signal sample_data_int           : std_logic_vector(15 downto 0);
+    signal shiftreg_data             : std_logic_vector(15 downto 0); -- to the input shiftregs
+    signal divisor                   : std_logic_vector(23 downto 0); -- sample_rate_divisor or 0 in ddr and peak mode
+    signal state_sync                : vector16_arr_t(0 to 2); -- input register'd for state mode, 0 is newest
+    signal state_tick                : std_logic; -- edge of the external clock between state_sync 2 and 1
     signal input_write_reg           : std_logic; -- used to switch between the two input shift regs
     signal last_input_write_reg      : std_logic;
     signal input_shift_in            : std_logic_vector(0 to 1); -- enable shift into input shiftreg
@@ -74,7 +142,17 @@ architecture behavioral of sample is
     
     attribute TIG : string;
     attribute TIG of sample_rate_divisor : signal is "TRUE";
+    attribute TIG of sample_rate_num : signal is "TRUE";
+    attribute TIG of sample_rate_den : signal is "TRUE";
     attribute TIG of channel_select : signal is "TRUE";
+    attribute TIG of ddr : signal is "TRUE";
+    attribute TIG of state_mode : signal is "TRUE";
+    attribute TIG of state_falling : signal is "TRUE";
+    attribute TIG of state_qualify : signal is "TRUE";
+    attribute TIG of state_qualify_level : signal is "TRUE";
+    attribute TIG of state_qualify_chan : signal is "TRUE";
+    attribute TIG of glitch_width : signal is "TRUE";
+    attribute TIG of peak_window : signal is "TRUE";
     
     signal DEBUG : boolean := false;--true;
     signal count : unsigned(31 downto 0);
@@ -90,6 +168,37 @@ begin
             output     => sample_run_get
         );
 
+    -- static while sampling
+    divisor <= (others=>'0') when (ddr = '1') or (peak_enable = '1') else sample_rate_divisor;
+    frac_enable <= '1' when (unsigned(sample_rate_num) /= 0) and (unsigned(divisor) /= 0) else '0';
+    frac_num_minus_den <= signed(resize(unsigned(sample_rate_num), 18)) - signed(resize(unsigned(sample_rate_den), 18));
+
+    -- detect edge of the external clock in state mode
+    state_tick <= '1' when (state_sync(2)(15) = state_falling) and (state_sync(1)(15) /= state_falling) and
+                           ((state_qualify = '0') or
+                            (state_sync(2)(to_integer(state_qualify_chan)) = state_qualify_level)) else '0';
+
+    -- glitch filter, one more clock of latency in timing mode only. in
+    -- state mode logic_data_reg must stay aligned with sample_tick
+    glitch_filter_inst : entity work.glitch_filter
+        port map(
+            clk      => sample_clk,
+            width    => glitch_width,
+            data_in  => logic_data_reg,
+            data_out => filtered_data
+        );
+    input_data <= logic_data_reg when (ddr = '1') or (state_mode = '1') else filtered_data;
+
+    -- peak detect: a min and a max sample at the end of each window, with
+    -- sample_tick on every clock (divisor 0) so no input is skipped. the
+    -- input shiftregs take the data one clock after the tick, so they get
+    -- the registered sample_data instead of input_data
+    peak_enable <= '1' when (unsigned(peak_window) > 1) and (ddr = '0') and (state_mode = '0') else '0';
+    take_tick <= peak_tick when (peak_enable = '1') else sample_tick;
+    take_data <= peak_data when (peak_enable = '1') else input_data;
+    shiftreg_data <= sample_data_int when (peak_enable = '1') else input_data;
+    sample_data <= sample_data_int;
+
     -- input shiftregs
     gen : for i in 0 to 1 generate
     begin
@@ -97,7 +206,9 @@ begin
             port map (
                 clk       => sample_clk,
                 shift_in  => input_shift_in(i),
-                data_in   => logic_data_reg,
+                double    => ddr,
+                data_in   => shiftreg_data,
+                data_in_2 => logic_data_reg_2,
                 shift_out => input_shift_out(i),
                 data_out  => input_shiftreg_data(i)
             );
@@ -110,18 +221,61 @@ begin
     begin
         if rising_edge(sample_clk) then
             -- divide sample clock
-            if (sample_run_get = '1') and (fifo_ready = '1') then
-                if (sample_tick_count = 0) then
-                    sample_tick_count <= unsigned(sample_rate_divisor);
-                else
+            -- the fractional accumulator adds num to acc with every tick, when
+            -- it wraps at den the next sample period is one clock longer.
+            -- sum and diff are register'd, they are valid again when the
+            -- next tick comes because the fraction is only used for div >= 1
+            frac_sum <= resize(frac_acc, 17) + resize(unsigned(sample_rate_num), 17);
+            frac_diff <= signed(resize(frac_acc, 18)) + frac_num_minus_den;
+            sample_tick <= '0';
+            if (state_mode = '1') then
+                -- tick on the external clock
+                sample_tick <= state_tick and sample_run_get and fifo_ready;
+            elsif (sample_run_get = '1') and (fifo_ready = '1') then
+                if (sample_tick_count /= 0) then
                     sample_tick_count <= sample_tick_count - 1;
+                elsif (frac_stall = '1') then
+                    frac_stall <= '0';
+                else
+                    sample_tick <= '1';
+                    sample_tick_count <= unsigned(divisor);
+                    if (frac_enable = '1') then
+                        if (frac_diff(frac_diff'high) = '0') then
+                            frac_acc <= unsigned(frac_diff(15 downto 0));
+                            frac_stall <= '1';
+                        else
+                            frac_acc <= frac_sum(15 downto 0);
+                        end if;
+                    end if;
                 end if;
             else
-                sample_tick_count <= unsigned(sample_rate_divisor);
+                sample_tick_count <= (others=>'0');
+                frac_acc <= (others=>'0');
+                frac_stall <= '0';
             end if;
-            sample_tick <= '0';
-            if (sample_tick_count = 0) then
-                sample_tick <= '1';
+
+            -- min and max of each window, the max on the clock after the min
+            peak_tick <= '0';
+            if (peak_max_pending = '1') then
+                peak_tick <= '1';
+                peak_data <= peak_max_out;
+                peak_max_pending <= '0';
+            end if;
+            if (sample_tick = '1') then
+                if (peak_left = 0) then
+                    -- last sample of the window
+                    peak_tick <= '1';
+                    peak_data <= peak_min and input_data;
+                    peak_max_out <= peak_max or input_data;
+                    peak_max_pending <= '1';
+                    peak_min <= (others=>'1');
+                    peak_max <= (others=>'0');
+                    peak_left <= unsigned(peak_window) - 1;
+                else
+                    peak_min <= peak_min and input_data;
+                    peak_max <= peak_max or input_data;
+                    peak_left <= peak_left - 1;
+                end if;
             end if;
 
             -- write data from input shiftreg to fifo
@@ -134,21 +288,43 @@ begin
                 fifo_write_int <= fifo_write_sequence(0);
                 fifo_write_sequence <= fifo_write_sequence(0) & fifo_write_sequence(15 downto 1);
                 fifo_write_count <= fifo_write_count + 1;
-                if (fifo_write_count = 15) then
+                if (fifo_write_count = 15) or ((ddr = '1') and (fifo_write_count(2 downto 0) = 7)) then
+                    -- all (ddr: the lower 8) channels written
                     write_to_fifo <= '0';
                 end if;
             end if;
 
             -- read input
-            logic_data_reg <= logic_data;
+            state_sync <= logic_data & state_sync(0 to 1);
+            if (state_mode = '1') then
+                -- take the sample before the external clock edge, it is
+                -- used with sample_tick from the same edge detection
+                logic_data_reg <= state_sync(2);
+            elsif (ddr = '1') then
+                -- pair the rising edge sample with the following falling edge one
+                logic_data_rise <= logic_data_iddr;
+                logic_data_reg <= x"00" & logic_data_rise;
+                logic_data_reg_2 <= x"00" & logic_data_fall;
+            else
+                logic_data_reg <= logic_data;
+            end if;
             input_shift_in <= (others=>'0');
-            if (sample_run_get = '1') and (fifo_ready = '1') and (sample_tick = '1') then
+            sample_data_int <= take_data;
+            sample_valid <= '0';
+            sample_active <= sample_run_get and fifo_ready;
+            if (sample_run_get = '1') and (fifo_ready = '1') and (take_tick = '1') then
+                -- pass sample to the encoders
+                sample_valid <= '1';
                 -- shift data into currently active input shiftreg
                 input_shift_in(sl2int(input_write_reg)) <= '1';
                 -- shift enabled channels from other input shiftreg to fifo
                 --input_shift_out(sl2int(not input_write_reg)) <= '1';
                 -- count sample to know when to switch between input shiftreg etc.
-                sample_count <= sample_count + 1;
+                if (ddr = '1') then
+                    sample_count <= sample_count + 2;
+                else
+                    sample_count <= sample_count + 1;
+                end if;
                 if (sample_count = 16) then
                     -- 16th sample so the first input shiftreg is full next clock edge
                     input_shiftreg_data_valid <= '1';
@@ -174,10 +350,8 @@ begin
                end if;
             end if;
 
-            -- check for overflow
-            if (fifo_ready = '1') and (fifo_full = '1') then
-                -- FIXME: set some status bit?
-            end if;
+            -- writes while fifo_full is set are lost, they are counted by
+            -- the telemetry unit in mainmodule
             
             -- reset
             fifo_reset <= '0';
@@ -189,8 +363,18 @@ begin
                 last_input_write_reg <= '0';
                 input_shiftreg_data_valid <= '0';
                 write_to_fifo <= '0';
-                fifo_write_sequence <= channel_select;
+                if (ddr = '1') then
+                    -- sequence is rotated by 8 after each block
+                    fifo_write_sequence <= channel_select(7 downto 0) & channel_select(7 downto 0);
+                else
+                    fifo_write_sequence <= channel_select;
+                end if;
                 fifo_write_count <= (others=>'0');
+                peak_left <= unsigned(peak_window) - 1;
+                peak_min <= (others=>'1');
+                peak_max <= (others=>'0');
+                peak_max_pending <= '0';
+                peak_tick <= '0';
                 fifo_ready <= '0';
                 fifo_data <= (others=>'0');
                 fifo_reset <= '1';
@@ -199,6 +383,27 @@ begin
             
         end if;
     end process;
+
+    -- ddr input registers in the iob, Q1 is aligned to the rising edge
+    sample_clk_n <= not sample_clk;
+    ddr_gen : for i in 0 to 7 generate
+    begin
+        iddr2_inst : IDDR2
+            generic map(
+                DDR_ALIGNMENT => "C0",
+                SRTYPE        => "SYNC"
+            )
+            port map(
+                Q0 => logic_data_iddr(i),
+                Q1 => logic_data_fall(i),
+                C0 => sample_clk,
+                C1 => sample_clk_n,
+                CE => '1',
+                D  => logic_data(i),
+                R  => '0',
+                S  => '0'
+            );
+    end generate ddr_gen;
     
 end behavioral;
 
@@ -0,0 +1,110 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- sample-major encoder for up to 8 channels
+--
+-- the enabled channels of each sample are packed into one byte, the lowest
+-- enabled channel is bit 0 (if more than 8 channels are enabled only the lowest
+-- 8 of them are used). two samples are written per fifo word, the first one in
+-- the low byte, so the fx2 delivers one byte per sample in order
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity sample_major is
+    port(
+        clk        : in std_logic; -- sample clock
+        enable     : in std_logic; -- '1' to encode, '0' to reset
+        data_mask  : in std_logic_vector(15 downto 0); -- enabled channels, async (must only be changed while enable is inactive)
+        data_in    : in std_logic_vector(15 downto 0); -- sampled input word
+        data_valid : in std_logic; -- data_in holds a new sample
+        fifo_data  : out std_logic_vector(15 downto 0) := (others=>'0'); -- data to fifo
+        fifo_write : out std_logic := '0' -- tell fifo to write data on next clock
+    );
+end sample_major;
+
+
+architecture behavioral of sample_major is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+    type select_t is array (0 to 7) of vector16_t;
+
+    signal channel_bit : select_t; -- one hot input channel of each output bit
+    signal low_byte    : std_logic_vector(7 downto 0); -- first sample of the word
+    signal have_low    : std_logic := '0';
+
+    attribute TIG : string;
+    attribute TIG of data_mask : signal is "TRUE";
+
+begin
+
+    -- find the channel of each output bit, static while sampling
+    process(data_mask)
+        variable n : integer;
+    begin
+        channel_bit <= (others=>(others=>'0'));
+        n := 0;
+        for i in 0 to 15 loop
+            if (data_mask(i) = '1') and (n < 8) then
+                channel_bit(n)(i) <= '1';
+                n := n + 1;
+            end if;
+        end loop;
+    end process;
+
+    process(clk)
+        variable b : std_logic_vector(7 downto 0);
+    begin
+        if rising_edge(clk) then
+            fifo_write <= '0';
+
+            if (data_valid = '1') then
+                for k in 0 to 7 loop
+                    if ((data_in and channel_bit(k)) /= x"0000") then
+                        b(k) := '1';
+                    else
+                        b(k) := '0';
+                    end if;
+                end loop;
+                if (have_low = '0') then
+                    low_byte <= b;
+                    have_low <= '1';
+                else
+                    fifo_data <= b & low_byte;
+                    fifo_write <= '1';
+                    have_low <= '0';
+                end if;
+            end if;
+
+            -- reset
+            if (enable = '0') then
+                have_low <= '0';
+                fifo_write <= '0';
+            end if;
+        end if;
+    end process;
+
+end behavioral;
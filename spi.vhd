@@ -26,6 +26,13 @@
 -- when data is written it is put onto data_out bus and enable_write is strobed
 -- when data is read enable_read is strobed and data must be put onto data_in
 --
+-- more data bytes can follow while slave select stays active (burst), the
+-- address is incremented after each one. when reading, the data of the next
+-- address is loaded right after a byte was sent, so the register after the
+-- last one sent is read too. registers with a side effect on reading must act
+-- on read_done instead of enable_read, it is strobed when a byte was sent
+-- completely (with addr still the address of that byte)
+--
 ----------------------------------------------------------------------------------
 
 library ieee;
@@ -45,6 +52,7 @@ entity spi is
         -- communication with other logic
         enable_write : out std_logic; -- write data to address
         enable_read  : out std_logic; -- laod data from address
+        read_done    : out std_logic; -- data loaded from address was sent
         addr         : out std_logic_vector(6 downto 0); -- address
         data_out     : out std_logic_vector(7 downto 0); -- data to write
         data_in      : in std_logic_vector(7 downto 0) -- loaded data
@@ -61,29 +69,36 @@ architecture behavioral of spi is
         load_data, -- if read: load data from address
         load_data_wait, -- if read: wait for data
         recv_send_data, -- recv/send data
-        recv_send_data_done -- if write: store data to address
+        recv_send_data_done, -- if write: store data to address
+        next_addr, -- increment address for the next byte of a burst
+        load_next_data -- if read: load data from next address
     );
     
     signal state     : state_t;
     signal bit_count : unsigned(2 downto 0); -- bit counter
     signal bits      : unsigned(7 downto 0); -- data
+    signal ss_n_sync : std_logic_vector(1 downto 0); -- inputs sync'd to clk
+    signal sclk_sync : std_logic_vector(1 downto 0);
+    signal mosi_sync : std_logic_vector(1 downto 0);
     signal ss_n_last : std_logic;
     signal sclk_last : std_logic;
     signal read_flag : std_logic; -- 0: write, 1: read
+    signal addr_int  : unsigned(6 downto 0);
 
 begin
 
-    -- FIXME: increase address after read/write?
-   
+    addr <= std_logic_vector(addr_int);
+
     process(clk)
     begin
         if rising_edge(clk) then
             enable_write <= '0';
             enable_read <= '0';
+            read_done <= '0';
             if (reset = '1') then
                 state <= idle;
             elsif (state = idle) then
-                if (ss_n_last = '1' and ss_n = '0') then -- slave select
+                if (ss_n_last = '1' and ss_n_sync(1) = '0') then -- slave select
                     state <= recv_addr;
                     bit_count <= (others=>'0');
                     bits <= (others=>'0');
@@ -91,12 +106,12 @@ begin
                     miso <= '0';
                 end if;
             elsif (state = recv_addr or state = recv_send_data) then
-                if (ss_n = '1') then
+                if (ss_n_sync(1) = '1') then
                     state <= idle;
-                elsif (sclk_last = '0' and sclk = '1') then -- rising edge
+                elsif (sclk_last = '0' and sclk_sync(1) = '1') then -- rising edge
                     -- shift in/out one bit
                     miso <= bits(7);
-                    bits <= bits(6 downto 0) & mosi;
+                    bits <= bits(6 downto 0) & mosi_sync(1);
                     if (bit_count = 7) then -- byte received
                         if (state = recv_addr) then
                             state <= recv_addr_done;
@@ -108,7 +123,7 @@ begin
                 end if;
             elsif (state = recv_addr_done) then
                 read_flag <= bits(7);
-                addr <= std_logic_vector(bits(6 downto 0));
+                addr_int <= bits(6 downto 0);
                 if (bits(7) = '1') then -- read
                     state <= load_data;
                     enable_read <= '1';
@@ -123,15 +138,30 @@ begin
                 bits <= unsigned(data_in);
                 state <= recv_send_data;
             elsif (state = recv_send_data_done) then
-                state <= recv_send_data;
+                state <= next_addr;
                 if (read_flag = '0') then -- write
                     data_out <= std_logic_vector(bits);
                     enable_write <= '1';
+                else -- read
+                    read_done <= '1';
                 end if;
+            elsif (state = next_addr) then
+                addr_int <= addr_int + 1;
+                if (read_flag = '1') then -- read
+                    state <= load_next_data;
+                else -- write
+                    state <= recv_send_data;
+                end if;
+            elsif (state = load_next_data) then
+                state <= load_data;
+                enable_read <= '1';
             end if;
             
-            ss_n_last <= ss_n;
-            sclk_last <= sclk;
+            ss_n_sync <= ss_n_sync(0) & ss_n;
+            sclk_sync <= sclk_sync(0) & sclk;
+            mosi_sync <= mosi_sync(0) & mosi;
+            ss_n_last <= ss_n_sync(1);
+            sclk_last <= sclk_sync(1);
         end if;
     end process;
     
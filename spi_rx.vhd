@@ -0,0 +1,117 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+----------------------------------------------------------------------------------
+--
+-- spi receiver for the protocol decoder, works on the sampled lines
+--
+-- mosi and miso are both taken on the sampling edge of sclk: the rising edge
+-- for modes 0 and 3 (cpol = cpha), the falling edge for modes 1 and 2. after 8
+-- bits both bytes are strobed. cs_n high (when use_cs is set) resets the bit
+-- count, the first byte after cs_n went low is flagged
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity spi_rx is
+    port(
+        clk        : in std_logic;
+        enable     : in std_logic; -- '1' to receive, '0' to reset
+        cpol       : in std_logic; -- idle level of sclk, async (must only be changed while enable is inactive)
+        cpha       : in std_logic; -- '1': data is taken on the second edge, async (same)
+        lsb_first  : in std_logic; -- async (same)
+        use_cs     : in std_logic; -- '0': cs_n is ignored, bytes are counted from the start, async (same)
+        sclk       : in std_logic;
+        cs_n       : in std_logic;
+        mosi       : in std_logic;
+        miso       : in std_logic;
+        data_valid : in std_logic; -- the lines hold a new sample
+        mosi_data  : out std_logic_vector(7 downto 0) := (others=>'0');
+        miso_data  : out std_logic_vector(7 downto 0) := (others=>'0');
+        first      : out std_logic := '0'; -- first byte since cs_n went low
+        strobe     : out std_logic := '0' -- mosi_data, miso_data and first hold a received byte
+    );
+end spi_rx;
+
+
+architecture behavioral of spi_rx is
+
+    signal last_sclk     : std_logic := '0';
+    signal sample_level  : std_logic; -- sclk level after the sampling edge
+    signal bit_count     : unsigned(2 downto 0) := (others=>'0');
+    signal mosi_shiftreg : std_logic_vector(7 downto 0);
+    signal miso_shiftreg : std_logic_vector(7 downto 0);
+    signal first_pending : std_logic := '1'; -- no byte since cs_n went low
+
+    attribute TIG : string;
+    attribute TIG of cpol : signal is "TRUE";
+    attribute TIG of cpha : signal is "TRUE";
+    attribute TIG of lsb_first : signal is "TRUE";
+    attribute TIG of use_cs : signal is "TRUE";
+
+begin
+
+    sample_level <= not (cpol xor cpha);
+
+    process(clk)
+        variable mosi_next : std_logic_vector(7 downto 0);
+        variable miso_next : std_logic_vector(7 downto 0);
+    begin
+        if rising_edge(clk) then
+            strobe <= '0';
+            if (data_valid = '1') then
+                last_sclk <= sclk;
+                if (use_cs = '1') and (cs_n = '1') then
+                    bit_count <= (others=>'0');
+                    first_pending <= '1';
+                elsif (sclk /= last_sclk) and (sclk = sample_level) then
+                    if (lsb_first = '1') then
+                        mosi_next := mosi & mosi_shiftreg(7 downto 1);
+                        miso_next := miso & miso_shiftreg(7 downto 1);
+                    else
+                        mosi_next := mosi_shiftreg(6 downto 0) & mosi;
+                        miso_next := miso_shiftreg(6 downto 0) & miso;
+                    end if;
+                    mosi_shiftreg <= mosi_next;
+                    miso_shiftreg <= miso_next;
+                    bit_count <= bit_count + 1;
+                    if (bit_count = 7) then
+                        mosi_data <= mosi_next;
+                        miso_data <= miso_next;
+                        first <= first_pending;
+                        first_pending <= '0';
+                        strobe <= '1';
+                    end if;
+                end if;
+            end if;
+
+            -- reset
+            if (enable = '0') then
+                last_sclk <= cpol;
+                bit_count <= (others=>'0');
+                first_pending <= '1';
+            end if;
+        end if;
+    end process;
+
+end behavioral;
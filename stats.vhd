@@ -0,0 +1,214 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+----------------------------------------------------------------------------------
+--
+-- statistics: counts the edges and the samples at high level of each channel
+-- over a gate of gate_period samples (ENCODING_STATISTICS, nothing is written
+-- to the fifo)
+--
+-- the 32 counts (edges of channel i at 2*i, high samples at 2*i+1) are kept
+-- in a distributed ram of 24 bit counters which saturate (bit 24 is set).
+-- one counter per clock is visited and gets the increments collected since
+-- its last visit in a 6 bit prescaler, so a full sweep takes 32 clocks.
+-- at the end of a gate the prescalers move to a residue and start over
+-- without losing a sample, the next sweep stores count + residue of each
+-- counter in the result ram. the gate number (counted from 1 since enable
+-- went high) and valid follow when the sweep is done, so gate_period must be
+-- at least 33 samples.
+-- while hold is set at the end of a gate its results are not stored, so
+-- result and gate can be read from another clock domain. the gates are still
+-- counted so a reader sees when results were dropped, hold takes effect
+-- within 34 clocks.
+-- frequency = edges / 2 / gate time, duty cycle = high / gate_period
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity stats is
+    port(
+        clk         : in std_logic; -- sample clock
+        enable      : in std_logic; -- '1' to count, '0' to reset
+        gate_period : in unsigned(31 downto 0); -- samples per gate, at least 33, async (must only be changed while enable is inactive)
+        hold        : in std_logic; -- don't store the results of the next gates (sync'd to clk)
+        data_in     : in std_logic_vector(15 downto 0); -- sampled input word
+        data_valid  : in std_logic; -- data_in holds a new sample
+        valid       : out std_logic := '0'; -- a gate was stored since enable went high
+        gate        : out unsigned(31 downto 0) := (others=>'0'); -- number of the stored gate
+        result_addr : in unsigned(4 downto 0); -- counter to read, 2*channel: edges, 2*channel+1: high samples (async)
+        result      : out std_logic_vector(24 downto 0) -- count of the stored gate, bit 24: saturated
+    );
+end stats;
+
+
+architecture behavioral of stats is
+
+    constant COUNTERS : integer := 32;
+
+    subtype count_t is unsigned(24 downto 0); -- bit 24: saturated
+    type count_arr_t is array (0 to COUNTERS-1) of count_t;
+    type pre_arr_t is array (0 to COUNTERS-1) of unsigned(5 downto 0);
+
+    -- first stage: edges and levels of a sample, end of gate
+    signal primed      : std_logic := '0'; -- last_data holds a sample
+    signal last_data   : std_logic_vector(15 downto 0) := (others=>'0');
+    signal gate_left   : unsigned(31 downto 0) := (others=>'0'); -- samples left in the gate - 1
+    signal inc_1       : std_logic_vector(COUNTERS-1 downto 0) := (others=>'0'); -- counters to increment
+    signal gate_end_1  : std_logic := '0'; -- sample is the last one of the gate
+
+    -- second stage: prescalers, one counter visited per clock
+    signal visit       : unsigned(4 downto 0) := (others=>'0'); -- counter moved to the ram
+    signal pre         : pre_arr_t := (others=>(others=>'0')); -- increments since the last visit
+    signal residue     : pre_arr_t := (others=>(others=>'0')); -- increments of the last gate not in the ram
+    signal flush       : std_logic_vector(COUNTERS-1 downto 0) := (others=>'0'); -- store the counter at the next visit
+    signal restart     : std_logic_vector(COUNTERS-1 downto 0) := (others=>'1'); -- ram is not cleared since enable
+    signal sweep       : unsigned(5 downto 0) := (others=>'0'); -- clocks until the last gate is stored
+    signal store       : std_logic := '0'; -- store the last gate (hold was not set)
+    signal gate_count  : unsigned(31 downto 0) := (others=>'0');
+
+    -- third stage: add to the counter, store the result at the end of a gate
+    signal index_3     : unsigned(4 downto 0) := (others=>'0');
+    signal count_3     : count_t := (others=>'0');
+    signal add_3       : unsigned(5 downto 0) := (others=>'0');
+    signal pre_3       : unsigned(5 downto 0) := (others=>'0');
+    signal replace_3   : std_logic := '0'; -- the counter starts over with pre_3
+    signal write_3     : std_logic := '0'; -- write the sum to the result ram
+
+    signal counts      : count_arr_t;
+    signal results     : count_arr_t;
+
+    attribute ram_style : string;
+    attribute ram_style of counts : signal is "distributed";
+    attribute ram_style of results : signal is "distributed";
+
+    attribute TIG : string;
+    attribute TIG of gate_period : signal is "TRUE";
+    attribute TIG of valid : signal is "TRUE";
+    attribute TIG of gate : signal is "TRUE";
+    attribute TIG of result : signal is "TRUE";
+
+begin
+
+    result <= std_logic_vector(results(to_integer(result_addr)));
+
+    process(clk)
+        variable k : integer range 0 to COUNTERS-1;
+        variable sum : count_t;
+    begin
+        if rising_edge(clk) then
+            -- first stage
+            inc_1 <= (others=>'0');
+            gate_end_1 <= '0';
+            if (data_valid = '1') then
+                last_data <= data_in;
+                primed <= '1';
+                for i in 0 to 15 loop
+                    inc_1(2*i) <= primed and (data_in(i) xor last_data(i));
+                    inc_1(2*i+1) <= data_in(i);
+                end loop;
+                if (gate_left = 0) then
+                    gate_end_1 <= '1';
+                    gate_left <= gate_period - 1;
+                else
+                    gate_left <= gate_left - 1;
+                end if;
+            end if;
+
+            -- second stage: the visited counter takes its prescaler, the
+            -- others count. at the end of a gate the prescalers (and this
+            -- sample) go to the residue and the next sweep stores them
+            k := to_integer(visit);
+            visit <= visit + 1;
+            index_3 <= visit;
+            count_3 <= counts(k);
+            pre_3 <= pre(k);
+            if (flush(k) = '1') then
+                add_3 <= residue(k);
+            else
+                add_3 <= pre(k);
+            end if;
+            replace_3 <= flush(k) or restart(k);
+            write_3 <= flush(k) and store;
+            for j in 0 to COUNTERS-1 loop
+                if (j = k) then
+                    flush(j) <= '0';
+                    restart(j) <= '0';
+                end if;
+                if (gate_end_1 = '1') then
+                    if (j = k) then
+                        residue(j) <= "00000" & inc_1(j);
+                    else
+                        residue(j) <= pre(j) + ("00000" & inc_1(j));
+                    end if;
+                    pre(j) <= (others=>'0');
+                    flush(j) <= '1';
+                elsif (j = k) then
+                    pre(j) <= "00000" & inc_1(j);
+                else
+                    pre(j) <= pre(j) + ("00000" & inc_1(j));
+                end if;
+            end loop;
+            if (sweep /= 0) then
+                sweep <= sweep - 1;
+                if (sweep = 1) and (store = '1') then
+                    gate <= gate_count;
+                    valid <= '1';
+                end if;
+            end if;
+            if (gate_end_1 = '1') then
+                gate_count <= gate_count + 1;
+                sweep <= to_unsigned(COUNTERS+1, sweep'length);
+                store <= not hold;
+            end if;
+
+            -- third stage
+            sum := ('0' & count_3(23 downto 0)) + add_3;
+            if (count_3(24) = '1') or (sum(24) = '1') then
+                sum := (others=>'1');
+            end if;
+            if (replace_3 = '1') then
+                if (write_3 = '1') then
+                    results(to_integer(index_3)) <= sum;
+                end if;
+                counts(to_integer(index_3)) <= resize(pre_3, count_t'length);
+            else
+                counts(to_integer(index_3)) <= sum;
+            end if;
+
+            if (enable = '0') then
+                primed <= '0';
+                gate_left <= gate_period - 1;
+                inc_1 <= (others=>'0');
+                gate_end_1 <= '0';
+                pre <= (others=>(others=>'0'));
+                flush <= (others=>'0');
+                restart <= (others=>'1');
+                sweep <= (others=>'0');
+                gate_count <= (others=>'0');
+                write_3 <= '0';
+                valid <= '0';
+            end if;
+        end if;
+    end process;
+
+end behavioral;
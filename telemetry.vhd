@@ -0,0 +1,136 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- capture statistics: overrun flags, words lost because the fifo was full,
+-- fifo high-water mark, words written and samples taken
+--
+-- all counters are cleared when a capture starts and keep their values after
+-- it stopped. they are copied to the outputs on a snapshot strobe, so the
+-- values read from the outputs belong together and don't change while the
+-- capture goes on
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity telemetry is
+    port(
+        clk              : in std_logic; -- sample clock
+        run              : in std_logic; -- '1' while sampling
+        snapshot         : in std_logic; -- copy counters to outputs (sync'd to clk)
+        sample_valid     : in std_logic; -- a sample was taken
+        fifo_write       : in std_logic; -- fifo enable_write
+        fifo_full        : in std_logic; -- fifo full flag, a write is lost while this is set
+        fifo_level       : in unsigned(15 downto 0); -- words in use in the fifo
+        encoder_overflow : in std_logic; -- strobed when an encoder lost data
+        flags            : out std_logic_vector(7 downto 0); -- bit0: fifo overrun, bit1: encoder overflow
+        dropped          : out unsigned(31 downto 0); -- words lost because the fifo was full
+        high_water       : out unsigned(15 downto 0); -- maximum fifo level
+        words            : out unsigned(31 downto 0); -- words written to the fifo
+        samples          : out unsigned(31 downto 0) -- samples taken
+    );
+end telemetry;
+
+
+architecture behavioral of telemetry is
+
+    -- inputs register'd, so the counters can be cleared on the rising edge
+    -- of run before the first sample is counted
+    signal run_reg            : std_logic := '0';
+    signal sample_valid_reg   : std_logic := '0';
+    signal fifo_write_reg     : std_logic := '0';
+    signal fifo_full_reg      : std_logic := '0';
+    signal overflow_reg       : std_logic := '0';
+    signal level_reg          : unsigned(15 downto 0) := (others=>'0');
+
+    signal overrun            : std_logic := '0';
+    signal overflow           : std_logic := '0';
+    signal dropped_count      : unsigned(31 downto 0) := (others=>'0');
+    signal high_water_level   : unsigned(15 downto 0) := (others=>'0');
+    signal words_count        : unsigned(31 downto 0) := (others=>'0');
+    signal samples_count      : unsigned(31 downto 0) := (others=>'0');
+
+    attribute TIG : string;
+    attribute TIG of flags : signal is "TRUE";
+    attribute TIG of dropped : signal is "TRUE";
+    attribute TIG of high_water : signal is "TRUE";
+    attribute TIG of words : signal is "TRUE";
+    attribute TIG of samples : signal is "TRUE";
+
+begin
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            run_reg <= run;
+            sample_valid_reg <= sample_valid;
+            fifo_write_reg <= fifo_write;
+            fifo_full_reg <= fifo_full;
+            overflow_reg <= encoder_overflow;
+            level_reg <= fifo_level;
+
+            -- count while sampling
+            if (run_reg = '1') then
+                if (sample_valid_reg = '1') then
+                    samples_count <= samples_count + 1;
+                end if;
+                if (fifo_write_reg = '1') then
+                    if (fifo_full_reg = '1') then
+                        overrun <= '1';
+                        dropped_count <= dropped_count + 1;
+                    else
+                        words_count <= words_count + 1;
+                    end if;
+                end if;
+                if (overflow_reg = '1') then
+                    overflow <= '1';
+                end if;
+                if (level_reg > high_water_level) then
+                    high_water_level <= level_reg;
+                end if;
+            end if;
+
+            -- clear counters at start of capture
+            if (run_reg = '0') and (run = '1') then
+                overrun <= '0';
+                overflow <= '0';
+                dropped_count <= (others=>'0');
+                high_water_level <= (others=>'0');
+                words_count <= (others=>'0');
+                samples_count <= (others=>'0');
+            end if;
+
+            -- latch values for reading
+            if (snapshot = '1') then
+                flags <= "000000" & overflow & overrun;
+                dropped <= dropped_count;
+                high_water <= high_water_level;
+                words <= words_count;
+                samples <= samples_count;
+            end if;
+        end if;
+    end process;
+
+end behavioral;
@@ -0,0 +1,159 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- self checking testbench for the ddr mode of the sample unit (runs with ghdl,
+-- see "make sim")
+--
+-- channels 0 to 7 are driven with a counter which is incremented every half
+-- sample clock. the checker reassembles the counter from the channel blocks
+-- written to the fifo and checks that every half clock sample is there once
+-- and in order
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity test_ddr is
+end test_ddr;
+
+architecture behavior of test_ddr is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+    type vector16_arr_t is array (natural range <>) of vector16_t;
+
+    constant block_count : natural := 200; -- blocks of 16 samples to check
+
+    --Inputs
+    signal sample_clk : std_logic := '0';
+    signal sample_run : std_logic := '0';
+    signal logic_data : vector16_t := (others=>'0');
+    signal fifo_full : std_logic := '0';
+
+    --Outputs
+    signal fifo_data : vector16_t;
+    signal fifo_reset : std_logic;
+    signal fifo_write : std_logic;
+
+    -- Clock period definitions
+    constant sample_clk_period : time := 10 ns;
+
+    signal done : boolean := false;
+    signal checked : natural := 0; -- blocks checked
+
+begin
+
+    -- Instantiate the Unit Under Test (UUT)
+    uut: entity work.sample
+        port map(
+            sample_clk          => sample_clk,
+            sample_run          => sample_run,
+            sample_rate_divisor => x"000005", -- ignored in ddr mode
+            ddr                 => '1',
+            logic_data          => logic_data,
+            channel_select      => x"00ff",
+            fifo_data           => fifo_data,
+            fifo_reset          => fifo_reset,
+            fifo_write          => fifo_write,
+            fifo_full           => fifo_full,
+            fifo_almost_full    => fifo_full
+        );
+
+    -- Clock process definitions
+    clk_process: process
+    begin
+        if done then
+            wait;
+        end if;
+        sample_clk <= '0';
+        wait for sample_clk_period/2;
+        sample_clk <= '1';
+        wait for sample_clk_period/2;
+    end process;
+
+    -- input counter, changes a quarter period after each clock edge
+    input_proc: process
+        variable n : unsigned(7 downto 0) := (others=>'0');
+    begin
+        wait on sample_clk;
+        wait for sample_clk_period/4;
+        logic_data(7 downto 0) <= std_logic_vector(n);
+        -- upper channels must not show up in ddr mode
+        logic_data(15 downto 8) <= std_logic_vector(not n);
+        n := n + 1;
+        if done then
+            wait;
+        end if;
+    end process;
+
+    -- Stimulus process
+    stim_proc: process
+    begin
+        sample_run <= '0';
+        wait for sample_clk_period*10;
+        sample_run <= '1';
+        wait until checked = block_count for sample_clk_period*16*block_count;
+        assert checked = block_count
+            report "checked " & integer'image(checked) & " blocks, expected " & integer'image(block_count)
+            severity failure;
+        report "test_ddr: " & integer'image(checked) & " blocks of 16 samples in order";
+        done <= true;
+        wait;
+    end process;
+
+    -- reassemble the counter from the channel blocks
+    check_proc: process(sample_clk)
+        variable words : vector16_arr_t(0 to 7);
+        variable count : natural := 0; -- words of the current block
+        variable value : unsigned(7 downto 0);
+        variable last : unsigned(7 downto 0);
+        variable started : boolean := false;
+    begin
+        if rising_edge(sample_clk) then
+            if (fifo_write = '1') then
+                words(count) := fifo_data;
+                count := count + 1;
+                if (count = 8) then
+                    count := 0;
+                    -- msb of each channel word is the first sample
+                    for j in 15 downto 0 loop
+                        for k in 0 to 7 loop
+                            value(k) := words(k)(j);
+                        end loop;
+                        if started then
+                            assert value = last + 1
+                                report "sample " & integer'image(to_integer(value)) & " after " &
+                                       integer'image(to_integer(last)) & " in block " & integer'image(checked)
+                                severity failure;
+                        end if;
+                        last := value;
+                        started := true;
+                    end loop;
+                    checked <= checked + 1;
+                end if;
+            end if;
+        end if;
+    end process;
+
+end;
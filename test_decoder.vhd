@@ -0,0 +1,338 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+----------------------------------------------------------------------------------
+--
+-- self checking testbench for the protocol decoder (runs with ghdl, see "make
+-- sim")
+--
+-- uart frames (with parity and framing errors), spi transfers and i2c
+-- transactions (with a repeated start and a nack) are sent on their channels
+-- one after the other, first with a sample every clock, then with a sample
+-- every third clock, then again every clock without the spi miso records.
+-- each record written to the fifo must match the next one expected, with a
+-- timestamp within its frame
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity test_decoder is
+end test_decoder;
+
+architecture behavior of test_decoder is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+    type vector16_arr_t is array (natural range <>) of vector16_t;
+    type natural_arr_t is array (natural range <>) of natural;
+    subtype byte_t is std_logic_vector(7 downto 0);
+    type byte_arr_t is array (natural range <>) of byte_t;
+
+    -- channels
+    constant UART_RX  : integer := 0;
+    constant SPI_SCLK : integer := 1;
+    constant SPI_CS   : integer := 2;
+    constant SPI_MOSI : integer := 3;
+    constant SPI_MISO : integer := 4;
+    constant I2C_SCL  : integer := 5;
+    constant I2C_SDA  : integer := 6;
+
+    constant uart_period : natural := 10; -- samples per bit
+    constant max_records : natural := 256;
+
+    -- configuration: uart with even parity, spi mode 0 msb first
+    constant uart_control : std_logic_vector(7 downto 0) := std_logic_vector(to_unsigned(UART_RX, 4)) & "0011";
+    constant uart_bit_period : std_logic_vector(15 downto 0) := std_logic_vector(to_unsigned(uart_period, 16));
+    constant spi_channels : std_logic_vector(15 downto 0) :=
+        std_logic_vector(to_unsigned(SPI_MISO, 4)) & std_logic_vector(to_unsigned(SPI_MOSI, 4)) &
+        std_logic_vector(to_unsigned(SPI_CS, 4)) & std_logic_vector(to_unsigned(SPI_SCLK, 4));
+    constant i2c_control : std_logic_vector(7 downto 0) := x"01";
+    constant i2c_channels : std_logic_vector(7 downto 0) :=
+        std_logic_vector(to_unsigned(I2C_SDA, 4)) & std_logic_vector(to_unsigned(I2C_SCL, 4));
+
+    --Inputs
+    signal clk : std_logic := '0';
+    signal enable : std_logic := '0';
+    signal data_in : std_logic_vector(15 downto 0) := (others=>'1');
+    signal data_valid : std_logic := '0';
+    signal spi_control : std_logic_vector(7 downto 0) := x"01"; -- bit5 (no miso records) set in the last pass
+
+    --Outputs
+    signal fifo_data : std_logic_vector(15 downto 0);
+    signal fifo_write : std_logic;
+    signal overflow : std_logic;
+
+    -- Clock period definitions
+    constant clk_period : time := 10 ns;
+
+    -- expected records, written by the stimulus before the frame is sent
+    signal exp_word : vector16_arr_t(0 to max_records-1);
+    signal exp_min : natural_arr_t(0 to max_records-1); -- timestamp range
+    signal exp_max : natural_arr_t(0 to max_records-1);
+    signal exp_count : natural := 0;
+    signal got_count : natural := 0;
+    signal errors : natural := 0;
+    signal done : boolean := false;
+
+begin
+
+    -- Instantiate the Unit Under Test (UUT)
+    uut: entity work.decoder
+        port map(
+            clk             => clk,
+            enable          => enable,
+            uart_control    => uart_control,
+            uart_bit_period => uart_bit_period,
+            spi_control     => spi_control,
+            spi_channels    => spi_channels,
+            i2c_control     => i2c_control,
+            i2c_channels    => i2c_channels,
+            data_in         => data_in,
+            data_valid      => data_valid,
+            fifo_data       => fifo_data,
+            fifo_write      => fifo_write,
+            overflow        => overflow
+        );
+
+    -- Clock process definitions
+    clk_process: process
+    begin
+        if done then
+            wait;
+        end if;
+        clk <= '0';
+        wait for clk_period/2;
+        clk <= '1';
+        wait for clk_period/2;
+    end process;
+
+    -- checker: compare the records with the expected ones
+    check_proc: process(clk)
+        variable words : vector16_arr_t(0 to 3);
+        variable n : natural := 0; -- words of the current record
+        variable k : natural := 0; -- records
+        variable stamp : unsigned(47 downto 0);
+        variable e : natural := 0;
+    begin
+        if rising_edge(clk) then
+            if (overflow = '1') then
+                report "test_decoder: overflow" severity error;
+                e := e + 1;
+            end if;
+            if (fifo_write = '1') then
+                words(n) := fifo_data;
+                n := n + 1;
+                if (n = 4) then
+                    n := 0;
+                    stamp := unsigned(words(3)) & unsigned(words(2)) & unsigned(words(1));
+                    if (k >= exp_count) then
+                        report "test_decoder: unexpected record " &
+                               integer'image(to_integer(unsigned(words(0)))) severity error;
+                        e := e + 1;
+                    elsif (words(0) /= exp_word(k)) then
+                        report "test_decoder: record " & integer'image(k) & " is " &
+                               integer'image(to_integer(unsigned(words(0)))) & ", expected " &
+                               integer'image(to_integer(unsigned(exp_word(k)))) severity error;
+                        e := e + 1;
+                    elsif (stamp < exp_min(k)) or (stamp > exp_max(k)) then
+                        report "test_decoder: record " & integer'image(k) & " at sample " &
+                               integer'image(to_integer(stamp)) & ", expected " & integer'image(exp_min(k)) &
+                               " to " & integer'image(exp_max(k)) severity error;
+                        e := e + 1;
+                    end if;
+                    k := k + 1;
+                end if;
+            end if;
+            got_count <= k;
+            errors <= e;
+        end if;
+    end process;
+
+    -- Stimulus process
+    stim_proc: process
+        variable index : natural := 0; -- number of the next sample
+        variable gap : natural := 0; -- clocks without a sample after each one
+        variable count : natural := 0; -- expected records
+
+        procedure tick(samples : in natural) is
+        begin
+            for i in 1 to samples loop
+                data_valid <= '1';
+                wait until rising_edge(clk);
+                index := index + 1;
+                for j in 1 to gap loop
+                    data_valid <= '0';
+                    wait until rising_edge(clk);
+                end loop;
+            end loop;
+            data_valid <= '0';
+        end tick;
+
+        procedure expect(word : in vector16_t; samples : in natural) is
+        begin
+            exp_word(count) <= word;
+            exp_min(count) <= index;
+            exp_max(count) <= index + samples;
+            count := count + 1;
+            exp_count <= count;
+        end expect;
+
+        procedure uart_send(b : in byte_t; bad_parity : in std_logic; bad_stop : in std_logic) is
+            variable p : std_logic := '0';
+        begin
+            expect("00" & "0000" & bad_parity & bad_stop & b, 13*uart_period);
+            data_in(UART_RX) <= '0';
+            tick(uart_period);
+            for i in 0 to 7 loop
+                data_in(UART_RX) <= b(i);
+                p := p xor b(i);
+                tick(uart_period);
+            end loop;
+            data_in(UART_RX) <= p xor bad_parity;
+            tick(uart_period);
+            data_in(UART_RX) <= not bad_stop;
+            tick(uart_period);
+            data_in(UART_RX) <= '1';
+            tick(2*uart_period);
+        end uart_send;
+
+        procedure spi_transfer(mosi : in byte_arr_t; miso : in byte_arr_t) is
+            variable first : std_logic := '1';
+        begin
+            for i in mosi'range loop
+                expect("01" & "0000" & first & '0' & mosi(i), 12 + 48*mosi'length);
+                if (spi_control(5) = '0') then
+                    expect("01" & "0000" & first & '1' & miso(i), 12 + 48*mosi'length);
+                end if;
+                first := '0';
+            end loop;
+            data_in(SPI_CS) <= '0';
+            data_in(SPI_SCLK) <= '0';
+            tick(3);
+            for i in mosi'range loop
+                for j in 7 downto 0 loop
+                    data_in(SPI_SCLK) <= '0';
+                    data_in(SPI_MOSI) <= mosi(i)(j);
+                    data_in(SPI_MISO) <= miso(i)(j);
+                    tick(3);
+                    data_in(SPI_SCLK) <= '1';
+                    tick(3);
+                end loop;
+            end loop;
+            data_in(SPI_SCLK) <= '0';
+            tick(3);
+            data_in(SPI_CS) <= '1';
+            tick(6);
+        end spi_transfer;
+
+        -- one bit on scl/sda, sda changes while scl is low
+        procedure i2c_bit(b : in std_logic) is
+        begin
+            data_in(I2C_SDA) <= b;
+            tick(2);
+            data_in(I2C_SCL) <= '1';
+            tick(4);
+            data_in(I2C_SCL) <= '0';
+            tick(2);
+        end i2c_bit;
+
+        -- start (or repeated start), bytes with their ack bits, no stop
+        procedure i2c_send(bytes : in byte_arr_t; acks : in std_logic_vector) is
+        begin
+            expect("10" & "000" & "010" & x"00", 12);
+            data_in(I2C_SDA) <= '1';
+            tick(2);
+            data_in(I2C_SCL) <= '1';
+            tick(4);
+            data_in(I2C_SDA) <= '0';
+            tick(4);
+            data_in(I2C_SCL) <= '0';
+            tick(2);
+            for i in bytes'range loop
+                expect("10" & "000" & "00" & acks(i) & bytes(i), 72);
+                for j in 7 downto 0 loop
+                    i2c_bit(bytes(i)(j));
+                end loop;
+                i2c_bit(acks(i));
+            end loop;
+        end i2c_send;
+
+        procedure i2c_stop is
+        begin
+            expect("10" & "000" & "100" & x"00", 12);
+            data_in(I2C_SDA) <= '0';
+            tick(2);
+            data_in(I2C_SCL) <= '1';
+            tick(4);
+            data_in(I2C_SDA) <= '1';
+            tick(6);
+        end i2c_stop;
+
+    begin
+        wait for clk_period*10;
+        wait until rising_edge(clk);
+
+        for pass in 0 to 2 loop
+            gap := 2*(pass mod 2);
+            if (pass = 2) then
+                spi_control <= x"21"; -- no miso records
+            end if;
+            index := 0;
+            data_in <= (others=>'1');
+            data_in(SPI_SCLK) <= '0';
+            enable <= '1';
+            tick(20);
+
+            -- uart
+            uart_send(x"55", '0', '0');
+            uart_send(x"a7", '0', '0');
+            uart_send(x"00", '1', '0'); -- parity error
+            uart_send(x"ff", '0', '1'); -- framing error
+            uart_send(x"3c", '0', '0');
+
+            -- spi, both bytes of a transfer complete at once
+            spi_transfer((x"9f", x"00", x"12"), (x"ff", x"c2", x"34"));
+            spi_transfer((0 => x"a5"), (0 => x"5a"));
+
+            -- i2c: write to 0x50, read it back after a repeated start
+            i2c_send((x"a0", x"10", x"42"), "000");
+            i2c_send((x"a1", x"42"), "01"); -- nack after the last byte read
+            i2c_stop;
+
+            tick(20);
+            wait for clk_period*20;
+            enable <= '0';
+            wait for clk_period*10;
+        end loop;
+
+        wait until rising_edge(clk);
+        assert got_count = exp_count
+            report "test_decoder: " & integer'image(got_count) & " records, expected " &
+                   integer'image(exp_count) severity failure;
+        assert errors = 0
+            report "test_decoder: " & integer'image(errors) & " errors" severity failure;
+        report "test_decoder: " & integer'image(got_count) & " records ok";
+        done <= true;
+        wait;
+    end process;
+
+end;
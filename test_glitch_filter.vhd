@@ -0,0 +1,165 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+----------------------------------------------------------------------------------
+--
+-- self checking testbench for the glitch filter (runs with ghdl, see "make
+-- sim")
+--
+-- channel i has width i. each channel gets pulses of pseudo random length
+-- from 1 to 32 clocks and the output is compared on every clock with a
+-- reference model: a channel takes a new level once the input had it for
+-- width clocks in a row. the pulses each channel passed and removed are
+-- reported, every channel with width > 1 must have removed some
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity test_glitch_filter is
+end test_glitch_filter;
+
+architecture behavior of test_glitch_filter is
+
+    type natural_arr_t is array (0 to 15) of natural;
+
+    constant run_clocks : natural := 50000;
+
+    --Inputs
+    signal clk : std_logic := '0';
+    signal width : std_logic_vector(63 downto 0);
+    signal data_in : std_logic_vector(15 downto 0) := (others=>'0');
+
+    --Outputs
+    signal data_out : std_logic_vector(15 downto 0);
+
+    -- Clock period definitions
+    constant clk_period : time := 10 ns;
+
+    signal done : boolean := false;
+
+begin
+
+    -- Instantiate the Unit Under Test (UUT)
+    uut: entity work.glitch_filter
+        port map(
+            clk      => clk,
+            width    => width,
+            data_in  => data_in,
+            data_out => data_out
+        );
+
+    gen : for i in 0 to 15 generate
+    begin
+        width(4*i+3 downto 4*i) <= std_logic_vector(to_unsigned(i, 4));
+    end generate gen;
+
+    -- Clock process definitions
+    clk_process: process
+    begin
+        if done then
+            wait;
+        end if;
+        clk <= '0';
+        wait for clk_period/2;
+        clk <= '1';
+        wait for clk_period/2;
+    end process;
+
+    -- Stimulus and reference process
+    stim_proc: process
+        variable lfsr : unsigned(31 downto 0) := x"12345678";
+        variable remain : natural_arr_t := (others=>2); -- clocks until the input changes, the filter starts with a stable input
+        variable run : natural_arr_t := (others=>0); -- clocks the input had its level
+        variable first : std_logic_vector(15 downto 0) := (others=>'1'); -- the initial level isn't a pulse
+        variable expected : std_logic_vector(15 downto 0) := (others=>'0');
+        variable passed, removed : natural_arr_t := (others=>0);
+        variable errors : natural := 0;
+        variable w : natural;
+    begin
+        wait until falling_edge(clk);
+        for t in 0 to run_clocks loop
+            -- new input pulses
+            for i in 0 to 15 loop
+                if (remain(i) = 0) then
+                    for j in 0 to 7 loop
+                        if (lfsr(0) = '1') then
+                            lfsr := ('0' & lfsr(31 downto 1)) xor x"80200003";
+                        else
+                            lfsr := '0' & lfsr(31 downto 1);
+                        end if;
+                    end loop;
+                    remain(i) := 1 + to_integer(lfsr(4 downto 0));
+                    -- a pulse is done, count it
+                    if (first(i) = '0') then
+                        if (run(i) >= i) then
+                            passed(i) := passed(i) + 1;
+                        else
+                            removed(i) := removed(i) + 1;
+                        end if;
+                    end if;
+                    data_in(i) <= not data_in(i);
+                    run(i) := 0;
+                    first(i) := '0';
+                end if;
+                remain(i) := remain(i) - 1;
+            end loop;
+
+            -- the filter takes the input at the rising edge, so does the model
+            wait until rising_edge(clk);
+            for i in 0 to 15 loop
+                run(i) := run(i) + 1;
+                w := i;
+                if (w = 0) then
+                    w := 1;
+                end if;
+                if (run(i) >= w) then
+                    expected(i) := data_in(i);
+                end if;
+            end loop;
+
+            wait until falling_edge(clk);
+            if (data_out /= expected) then
+                if (errors < 10) then
+                    report "test_glitch_filter: clock " & integer'image(t) & ": output " &
+                           integer'image(to_integer(unsigned(data_out))) & ", expected " &
+                           integer'image(to_integer(unsigned(expected))) severity error;
+                end if;
+                errors := errors + 1;
+            end if;
+        end loop;
+
+        for i in 0 to 15 loop
+            report "test_glitch_filter: width " & integer'image(i) & ": " & integer'image(passed(i)) &
+                   " pulses passed, " & integer'image(removed(i)) & " removed";
+            if (i > 1) and (removed(i) = 0) then
+                errors := errors + 1;
+            end if;
+        end loop;
+        assert errors = 0
+            report "test_glitch_filter: " & integer'image(errors) & " errors" severity failure;
+        report "test_glitch_filter: ok";
+        done <= true;
+        wait;
+    end process;
+
+end;
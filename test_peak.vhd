@@ -0,0 +1,222 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+----------------------------------------------------------------------------------
+--
+-- self checking testbench for the peak detect decimation of the sample unit
+-- (runs with ghdl, see "make sim")
+--
+-- each window has 5 sample clocks. channel 0 and 5 to 15 get a one clock
+-- pulse every 35 clocks (each at its own phase), channel 1 a one clock low
+-- pulse every 45 clocks, channel 2 stays low, channel 3 high and channel 4
+-- toggles every clock. the checker reassembles the min/max pairs from the
+-- channel blocks written to the fifo and checks that every pulse shows up in
+-- exactly one window. the capture is run with sample rate divisor 0 and then
+-- 9, which must be ignored, so the pulses are seen in both runs
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity test_peak is
+end test_peak;
+
+architecture behavior of test_peak is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+    type vector16_arr_t is array (natural range <>) of vector16_t;
+    type integer_arr_t is array (0 to 15) of integer;
+
+    constant block_count : natural := 100; -- blocks of 8 windows to check
+    constant window : natural := 5;
+
+    --Inputs
+    signal sample_clk : std_logic := '0';
+    signal sample_run : std_logic := '0';
+    signal logic_data : vector16_t := (others=>'0');
+    signal fifo_full : std_logic := '0';
+    signal divisor : std_logic_vector(23 downto 0) := x"000000";
+
+    --Outputs
+    signal fifo_data : vector16_t;
+    signal fifo_reset : std_logic;
+    signal fifo_write : std_logic;
+
+    -- Clock period definitions
+    constant sample_clk_period : time := 10 ns;
+
+    signal done : boolean := false;
+    signal checked : natural := 0; -- blocks checked
+
+begin
+
+    -- Instantiate the Unit Under Test (UUT)
+    uut: entity work.sample
+        port map(
+            sample_clk          => sample_clk,
+            sample_run          => sample_run,
+            sample_rate_divisor => divisor,
+            peak_window         => x"0005",
+            logic_data          => logic_data,
+            channel_select      => x"ffff",
+            fifo_data           => fifo_data,
+            fifo_reset          => fifo_reset,
+            fifo_write          => fifo_write,
+            fifo_full           => fifo_full,
+            fifo_almost_full    => fifo_full
+        );
+
+    -- Clock process definitions
+    clk_process: process
+    begin
+        if done then
+            wait;
+        end if;
+        sample_clk <= '0';
+        wait for sample_clk_period/2;
+        sample_clk <= '1';
+        wait for sample_clk_period/2;
+    end process;
+
+    -- input pulses, change at the falling edge
+    input_proc: process
+        variable t : natural := 0;
+    begin
+        wait until falling_edge(sample_clk);
+        logic_data <= (others=>'0');
+        if (t mod 35 = 0) then
+            logic_data(0) <= '1';
+        end if;
+        if (t mod 45 /= 0) then
+            logic_data(1) <= '1';
+        end if;
+        logic_data(3) <= '1';
+        if (t mod 2 = 0) then
+            logic_data(4) <= '1';
+        end if;
+        for c in 5 to 15 loop
+            if (t mod 35 = c) then
+                logic_data(c) <= '1';
+            end if;
+        end loop;
+        t := t + 1;
+        if done then
+            wait;
+        end if;
+    end process;
+
+    -- Stimulus process
+    stim_proc: process
+    begin
+        for pass in 0 to 1 loop
+            sample_run <= '0';
+            wait for sample_clk_period*10;
+            if (pass = 1) then
+                divisor <= x"000009";
+                wait for sample_clk_period*10;
+            end if;
+            sample_run <= '1';
+            wait until checked = block_count*(pass+1) for sample_clk_period*16*window*block_count;
+            assert checked = block_count*(pass+1)
+                report "divisor " & integer'image(to_integer(unsigned(divisor))) & ": checked " &
+                       integer'image(checked) & " blocks, expected " & integer'image(block_count*(pass+1))
+                severity failure;
+        end loop;
+        report "test_peak: " & integer'image(checked*8) & " windows ok";
+        done <= true;
+        wait;
+    end process;
+
+    -- reassemble the min/max pairs from the channel blocks
+    check_proc: process(sample_clk)
+        variable words : vector16_arr_t(0 to 15);
+        variable count : natural := 0; -- words of the current block
+        variable w : natural := 0; -- window
+        variable last : integer_arr_t := (others=>-1); -- last window with a pulse
+        variable mn, mx : std_logic;
+        variable pulse : boolean;
+        variable period : natural;
+    begin
+        if rising_edge(sample_clk) then
+            if (fifo_reset = '1') then
+                -- next run
+                count := 0;
+                w := 0;
+                last := (others=>-1);
+            end if;
+            if (fifo_write = '1') then
+                words(count) := fifo_data;
+                count := count + 1;
+                if (count = 16) then
+                    count := 0;
+                    -- msb of each channel word is the first sample, min then max
+                    for j in 7 downto 0 loop
+                        for c in 0 to 15 loop
+                            mn := words(c)(2*j+1);
+                            mx := words(c)(2*j);
+                            assert (mn = '0') or (mx = '1')
+                                report "channel " & integer'image(c) & " min > max in window " & integer'image(w)
+                                severity failure;
+                            if (c = 2) then
+                                assert (mn = '0') and (mx = '0')
+                                    report "channel 2 not low in window " & integer'image(w) severity failure;
+                            elsif (c = 3) then
+                                assert (mn = '1') and (mx = '1')
+                                    report "channel 3 not high in window " & integer'image(w) severity failure;
+                            elsif (c = 4) then
+                                assert (mn = '0') and (mx = '1')
+                                    report "channel 4 not toggled in window " & integer'image(w) severity failure;
+                            else
+                                -- pulse windows must be exactly period / window apart
+                                if (c = 1) then
+                                    assert mx = '1'
+                                        report "channel 1 low in window " & integer'image(w) severity failure;
+                                    pulse := mn = '0';
+                                    period := 45 / window;
+                                else
+                                    assert mn = '0'
+                                        report "channel " & integer'image(c) & " high in window " & integer'image(w)
+                                        severity failure;
+                                    pulse := mx = '1';
+                                    period := 35 / window;
+                                end if;
+                                if pulse then
+                                    assert (last(c) < 0) or (w - last(c) = period)
+                                        report "channel " & integer'image(c) & ": pulse in window " & integer'image(w) &
+                                               " after " & integer'image(last(c)) severity failure;
+                                    last(c) := w;
+                                else
+                                    assert (last(c) < 0) or (w - last(c) < period)
+                                        report "channel " & integer'image(c) & ": pulse missing after window " &
+                                               integer'image(last(c)) severity failure;
+                                end if;
+                            end if;
+                        end loop;
+                        w := w + 1;
+                    end loop;
+                    checked <= checked + 1;
+                end if;
+            end if;
+        end if;
+    end process;
+
+end;
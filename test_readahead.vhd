@@ -0,0 +1,206 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- self checking testbench for the read ahead buffer on the fx2 bus (runs with
+-- ghdl, see "make sim")
+--
+-- the source is a counter which pauses for a few clocks every 1024 words like
+-- the fifo does between its block rams. the fx2 is modelled in three modes:
+--   flow:      the flowstate waveform, reads on every clock where it saw ready
+--              a given number of clocks before and its fifo isn't full
+--   flow full: the same, with the ep2 fifo full now and then
+--   handshake: the old waveform, one clock to decide and one to read
+-- every word read is checked against the counter and the words per clock of
+-- each mode are reported
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity test_readahead is
+end test_readahead;
+
+architecture behavior of test_readahead is
+
+    type mode_t is (flow, flow_full, handshake);
+
+    constant window : integer := 8;
+    constant run_clocks : natural := 20000; -- clocks per phase
+
+    --Inputs
+    signal clk : std_logic := '0';
+    signal clear : std_logic := '1';
+    signal src_data : std_logic_vector(15 downto 0);
+    signal src_empty : std_logic := '1';
+    signal read : std_logic := '0';
+
+    --Outputs
+    signal src_read : std_logic;
+    signal data : std_logic_vector(15 downto 0);
+    signal ready : std_logic;
+
+    -- Clock period definitions
+    constant clk_period : time := 20.833 ns;
+
+    signal done : boolean := false;
+    signal mode : mode_t := flow;
+    signal latency : natural := 4; -- clocks from ready to the read
+    signal words : natural := 0; -- words read in this phase
+    signal clocks : natural := 0; -- clocks of this phase
+
+    signal src_count : unsigned(15 downto 0) := (others=>'0');
+    signal src_gap : natural := 0; -- clocks left of the gap
+    signal src_run : natural := 0; -- words since the last gap
+
+begin
+
+    -- Instantiate the Unit Under Test (UUT)
+    uut: entity work.readahead
+        generic map(
+            window => window
+        )
+        port map(
+            clk       => clk,
+            clear     => clear,
+            src_data  => src_data,
+            src_empty => src_empty,
+            src_read  => src_read,
+            data      => data,
+            read      => read,
+            ready     => ready
+        );
+
+    -- Clock process definitions
+    clk_process: process
+    begin
+        if done then
+            wait;
+        end if;
+        clk <= '0';
+        wait for clk_period/2;
+        clk <= '1';
+        wait for clk_period/2;
+    end process;
+
+    -- fifo model: counter, 4 clocks gap every 1024 words
+    src_data <= std_logic_vector(src_count);
+    src_empty <= '1' when (src_gap /= 0) or (clear = '1') else '0';
+    src_proc: process(clk)
+    begin
+        if rising_edge(clk) then
+            if (src_gap /= 0) then
+                src_gap <= src_gap - 1;
+            elsif (src_read = '1') and (clear = '0') then
+                src_count <= src_count + 1;
+                src_run <= src_run + 1;
+                if (src_run = 1023) then
+                    src_run <= 0;
+                    src_gap <= 4;
+                end if;
+            end if;
+            if (clear = '1') then
+                src_count <= (others=>'0');
+                src_run <= 0;
+                src_gap <= 0;
+            end if;
+        end if;
+    end process;
+
+    -- fx2 model and checker
+    fx2_proc: process(clk)
+        variable ready_delay : std_logic_vector(15 downto 0) := (others=>'0');
+        variable expected : unsigned(15 downto 0) := (others=>'0');
+        variable decided : boolean := false;
+        variable full : boolean;
+    begin
+        if rising_edge(clk) then
+            -- word read on this clock
+            if (read = '1') then
+                assert data = std_logic_vector(expected)
+                    report "read " & integer'image(to_integer(unsigned(data))) &
+                           ", expected " & integer'image(to_integer(expected))
+                    severity failure;
+                expected := expected + 1;
+                words <= words + 1;
+            end if;
+            clocks <= clocks + 1;
+
+            -- ready as seen by the gpif
+            ready_delay := ready_delay(14 downto 0) & ready;
+            full := (mode = flow_full) and (clocks mod 512 < 40);
+            read <= '0';
+            case mode is
+            when flow | flow_full =>
+                if (ready_delay(latency-1) = '1') and not full then
+                    read <= '1';
+                end if;
+            when handshake =>
+                if decided then
+                    read <= '1';
+                    decided := false;
+                elsif (ready_delay(latency-1) = '1') then
+                    decided := true;
+                end if;
+            end case;
+
+            if (clear = '1') then
+                expected := (others=>'0');
+                decided := false;
+                read <= '0';
+                words <= 0;
+                clocks <= 0;
+            end if;
+        end if;
+    end process;
+
+    -- Stimulus process
+    stim_proc: process
+        procedure run(m : mode_t; l : natural; min_rate : real) is
+            variable rate : real;
+        begin
+            wait until rising_edge(clk);
+            clear <= '1';
+            mode <= m;
+            latency <= l;
+            wait for clk_period*20;
+            wait until rising_edge(clk);
+            clear <= '0';
+            wait for clk_period*run_clocks;
+            rate := real(words) / real(clocks);
+            report "test_readahead: " & mode_t'image(m) & ", latency " & integer'image(l) & ": " &
+                   integer'image(words) & " words in " & integer'image(clocks) & " clocks, " &
+                   integer'image(integer(rate * 1000.0)) & "/1000 words per clock";
+            assert rate >= min_rate report "too slow" severity failure;
+        end run;
+    begin
+        run(flow, 4, 0.98);
+        run(flow, window-1, 0.98);
+        run(flow_full, window-1, 0.85);
+        run(handshake, 4, 0.45);
+        done <= true;
+        wait;
+    end process;
+
+end;
@@ -0,0 +1,214 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- self checking testbench for the rle unit (runs with ghdl, see "make sim")
+--
+-- the stimulus feeds a pseudo random sequence of runs into the encoder, a
+-- reference decoder expands the records written to the fifo again and compares
+-- them with the same sequence. at the end the last run is written by flush
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity test_rle is
+end test_rle;
+
+architecture behavior of test_rle is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+
+    -- test data generator, used by stimulus and reference decoder
+    type gen_t is record
+        lfsr   : unsigned(31 downto 0);
+        value  : vector16_t; -- value of the current run
+        remain : natural; -- samples left in the current run
+        runs   : natural; -- number of runs started
+    end record;
+    constant gen_init : gen_t := (lfsr => x"12345678", value => (others=>'0'), remain => 0, runs => 0);
+
+    constant run_count       : natural := 1000; -- number of runs to send
+    constant full_rate_runs  : natural := 500; -- runs sent with a sample every clock
+    constant long_run_index  : natural := 100; -- run longer than the maximum record length
+
+    procedure gen_next(g : inout gen_t; sample : out vector16_t) is
+        variable len : natural;
+    begin
+        if (g.remain = 0) then
+            -- start a new run
+            for i in 0 to 7 loop
+                if (g.lfsr(0) = '1') then
+                    g.lfsr := ('0' & g.lfsr(31 downto 1)) xor x"80200003";
+                else
+                    g.lfsr := '0' & g.lfsr(31 downto 1);
+                end if;
+            end loop;
+            -- flip one or two channels
+            g.value(to_integer(g.lfsr(3 downto 0))) := not g.value(to_integer(g.lfsr(3 downto 0)));
+            if (g.lfsr(4) = '1') and (g.lfsr(8 downto 5) /= g.lfsr(3 downto 0)) then
+                g.value(to_integer(g.lfsr(8 downto 5))) := not g.value(to_integer(g.lfsr(8 downto 5)));
+            end if;
+            -- runs of at least two samples while sampling at full rate
+            if (g.runs < full_rate_runs) then
+                len := 2 + to_integer(g.lfsr(11 downto 9));
+            else
+                len := 1 + to_integer(g.lfsr(11 downto 9));
+            end if;
+            if (g.runs = long_run_index) then
+                len := 70000;
+            elsif (g.runs mod 32 = 31) then
+                len := 1000;
+            end if;
+            g.remain := len;
+            g.runs := g.runs + 1;
+        end if;
+        g.remain := g.remain - 1;
+        sample := g.value;
+    end gen_next;
+
+    --Inputs
+    signal clk : std_logic := '0';
+    signal enable : std_logic := '0';
+    signal flush : std_logic := '0';
+    signal data_mask : vector16_t := (others=>'1');
+    signal data_in : vector16_t := (others=>'0');
+    signal data_valid : std_logic := '0';
+
+    --Outputs
+    signal fifo_data : vector16_t;
+    signal fifo_write : std_logic;
+    signal overflow : std_logic;
+
+    -- Clock period definitions
+    constant clk_period : time := 10 ns;
+
+    signal done : boolean := false;
+    signal sent_complete : natural := 0; -- samples sent in completed runs
+    signal decoded : natural := 0; -- samples decoded from the records
+
+begin
+
+    -- Instantiate the Unit Under Test (UUT)
+    uut: entity work.rle
+        port map(
+            clk        => clk,
+            enable     => enable,
+            flush      => flush,
+            data_mask  => data_mask,
+            data_in    => data_in,
+            data_valid => data_valid,
+            fifo_data  => fifo_data,
+            fifo_write => fifo_write,
+            overflow   => overflow
+        );
+
+    -- Clock process definitions
+    clk_process: process
+    begin
+        if done then
+            wait;
+        end if;
+        clk <= '0';
+        wait for clk_period/2;
+        clk <= '1';
+        wait for clk_period/2;
+    end process;
+
+    -- Stimulus process
+    stim_proc: process
+        variable g : gen_t := gen_init;
+        variable sample : vector16_t;
+        variable sent : natural := 0;
+    begin
+        enable <= '0';
+        wait for clk_period*5;
+        wait until rising_edge(clk);
+        enable <= '1';
+
+        loop
+            -- stop before starting the run after the last one
+            if (g.remain = 0) and (g.runs = run_count) then
+                exit;
+            end if;
+            if (g.remain = 0) then
+                sent_complete <= sent;
+            end if;
+            gen_next(g, sample);
+            sent := sent + 1;
+            data_in <= sample;
+            data_valid <= '1';
+            wait until rising_edge(clk);
+            data_valid <= '0';
+            -- divided sample rate for the later runs
+            if (g.runs > full_rate_runs) then
+                wait until rising_edge(clk);
+                wait until rising_edge(clk);
+            end if;
+        end loop;
+        data_valid <= '0';
+
+        -- the last run is only written by flush
+        wait for clk_period*20;
+        assert decoded = sent_complete
+            report "decoded " & integer'image(decoded) & " samples, expected " & integer'image(sent_complete)
+            severity failure;
+        flush <= '1';
+        wait for clk_period*20;
+        assert decoded = sent
+            report "decoded " & integer'image(decoded) & " samples after flush, expected " & integer'image(sent)
+            severity failure;
+        report "test_rle: " & integer'image(decoded) & " samples in " & integer'image(run_count) & " runs decoded ok";
+        done <= true;
+        wait;
+    end process;
+
+    -- reference decoder
+    check_proc: process(clk)
+        variable g : gen_t := gen_init;
+        variable expected : vector16_t;
+        variable value : vector16_t;
+        variable have_value : boolean := false;
+    begin
+        if rising_edge(clk) then
+            assert overflow = '0' report "rle overflow" severity failure;
+            if (fifo_write = '1') then
+                if not have_value then
+                    value := fifo_data;
+                    have_value := true;
+                else
+                    for i in 0 to to_integer(unsigned(fifo_data)) loop
+                        gen_next(g, expected);
+                        assert (expected and data_mask) = value
+                            report "wrong data at sample " & integer'image(decoded + i)
+                            severity failure;
+                    end loop;
+                    decoded <= decoded + to_integer(unsigned(fifo_data)) + 1;
+                    have_value := false;
+                end if;
+            end if;
+        end if;
+    end process;
+
+end;
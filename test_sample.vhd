@@ -34,7 +34,7 @@ architecture behavior of test_sample is
     port(
          sample_run : in std_logic;
          sample_clk : in std_logic;
-         sample_rate_divisor : in std_logic_vector(7 downto 0);
+         sample_rate_divisor : in std_logic_vector(23 downto 0);
          channel_select : in std_logic_vector(15 downto 0);
          logic_data : in std_logic_vector(15 downto 0);
          fifo_reset : out std_logic;
@@ -49,7 +49,7 @@ architecture behavior of test_sample is
     --Inputs
     signal sample_run : std_logic := '0';
     signal sample_clk : std_logic := '0';
-    signal sample_rate_divisor : std_logic_vector(7 downto 0) := std_logic_vector(to_unsigned(1, 8));
+    signal sample_rate_divisor : std_logic_vector(23 downto 0) := std_logic_vector(to_unsigned(1, 24));
     signal channel_select : std_logic_vector(15 downto 0) := (others => '1');
     signal logic_data : std_logic_vector(15 downto 0) := "0101010101010101";
     signal fifo_full : std_logic := '1';
@@ -89,7 +89,7 @@ BEGIN
         if (do_count = '1') then
             count2 <= count2 - 1;
             if (count2 = to_unsigned(0, count2'length)) then
-                count2 <= unsigned(sample_rate_divisor);
+                count2 <= unsigned(sample_rate_divisor(7 downto 0));
                 count <= count + 1;
                 for i in 0 to 15
                 loop
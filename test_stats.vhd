@@ -0,0 +1,232 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+----------------------------------------------------------------------------------
+--
+-- self checking testbench for the statistics unit (runs with ghdl, see "make
+-- sim")
+--
+-- a sample is taken on 7 of 8 clocks, channel i toggles with a probability
+-- of i/16 per sample. a reference model counts the edges and high samples of
+-- each gate. hold is set during every 4th gate, so the gate ending when it
+-- is set must be skipped, and once hold had time to take effect all 32
+-- counters are compared with the results of the gate shown
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity test_stats is
+end test_stats;
+
+architecture behavior of test_stats is
+
+    constant gates : natural := 40;
+    constant gate_samples : natural := 97;
+
+    type result_t is array (0 to 15) of natural;
+    type result_arr_t is array (1 to gates) of result_t;
+
+    --Inputs
+    signal clk : std_logic := '0';
+    signal gate_period : unsigned(31 downto 0) := to_unsigned(gate_samples, 32);
+    signal enable : std_logic := '0';
+    signal hold : std_logic := '0';
+    signal data_in : std_logic_vector(15 downto 0) := x"aaaa";
+    signal data_valid : std_logic := '0';
+
+    --Outputs
+    signal valid : std_logic;
+    signal gate : unsigned(31 downto 0);
+    signal result_addr : unsigned(4 downto 0) := (others=>'0');
+    signal result : std_logic_vector(24 downto 0);
+
+    -- Clock period definitions
+    constant clk_period : time := 10 ns;
+
+    -- results of the reference model
+    signal expected_edges : result_arr_t := (others=>(others=>0));
+    signal expected_high : result_arr_t := (others=>(others=>0));
+
+    signal done : boolean := false;
+
+begin
+
+    -- Instantiate the Unit Under Test (UUT)
+    uut: entity work.stats
+        port map(
+            clk         => clk,
+            enable      => enable,
+            gate_period => gate_period,
+            hold        => hold,
+            data_in     => data_in,
+            data_valid  => data_valid,
+            valid       => valid,
+            gate        => gate,
+            result_addr => result_addr,
+            result      => result
+        );
+
+    -- Clock process definitions
+    clk_process: process
+    begin
+        if done then
+            wait;
+        end if;
+        clk <= '0';
+        wait for clk_period/2;
+        clk <= '1';
+        wait for clk_period/2;
+    end process;
+
+    -- Stimulus and reference process
+    stim_proc: process
+        variable lfsr : unsigned(31 downto 0) := x"12345678";
+        variable data : std_logic_vector(15 downto 0) := x"aaaa";
+        variable last : std_logic_vector(15 downto 0);
+        variable first : boolean := true;
+        variable e, h : result_t := (others=>0);
+        variable n : natural := 0;
+        variable g : natural := 1;
+        variable t : natural := 0;
+    begin
+        wait for clk_period*4;
+        wait until falling_edge(clk);
+        enable <= '1';
+        while g <= gates loop
+            data_valid <= '0';
+            if (t mod 8 /= 7) then
+                last := data;
+                for i in 0 to 15 loop
+                    for j in 0 to 3 loop
+                        if (lfsr(0) = '1') then
+                            lfsr := ('0' & lfsr(31 downto 1)) xor x"80200003";
+                        else
+                            lfsr := '0' & lfsr(31 downto 1);
+                        end if;
+                    end loop;
+                    if (to_integer(lfsr(3 downto 0)) < i) then
+                        data(i) := not data(i);
+                    end if;
+                end loop;
+                data_in <= data;
+                data_valid <= '1';
+                -- count the sample
+                for i in 0 to 15 loop
+                    if (not first) and (data(i) /= last(i)) then
+                        e(i) := e(i) + 1;
+                    end if;
+                    if (data(i) = '1') then
+                        h(i) := h(i) + 1;
+                    end if;
+                end loop;
+                first := false;
+                n := n + 1;
+                if (n = gate_samples) then
+                    expected_edges(g) <= e;
+                    expected_high(g) <= h;
+                    e := (others=>0);
+                    h := (others=>0);
+                    n := 0;
+                    g := g + 1;
+                end if;
+            end if;
+            -- hold the outputs during every 4th gate
+            if (g mod 4 = 2) then
+                hold <= '1';
+            else
+                hold <= '0';
+            end if;
+            t := t + 1;
+            wait until falling_edge(clk);
+        end loop;
+        data_valid <= '0';
+        wait for clk_period*50;
+        done <= true;
+        wait;
+    end process;
+
+    -- follow the gate numbers, compare the counters while hold is set
+    check_proc: process
+        variable errors : natural := 0;
+        variable last_gate : natural := 0;
+        variable latched : natural := 0;
+        variable skipped : natural := 0;
+        variable checked : natural := 0;
+        variable held : natural := 0;
+        variable k : natural;
+        variable expected : natural;
+    begin
+        while not done loop
+            wait until falling_edge(clk);
+            if (hold = '1') then
+                held := held + 1;
+            else
+                held := 0;
+            end if;
+            if (valid = '1') then
+                k := to_integer(gate);
+                if (k /= last_gate) then
+                    latched := latched + 1;
+                    if (k > last_gate + 1) then
+                        skipped := skipped + k - last_gate - 1;
+                    end if;
+                    last_gate := k;
+                end if;
+                if (k < 1) or (k > gates) then
+                    report "test_stats: bad gate number " & integer'image(k) severity error;
+                    errors := errors + 1;
+                elsif (held = 40) then
+                    checked := checked + 1;
+                    for c in 0 to 31 loop
+                        result_addr <= to_unsigned(c, 5);
+                        wait for 100 ps;
+                        if (c mod 2 = 0) then
+                            expected := expected_edges(k)(c/2);
+                        else
+                            expected := expected_high(k)(c/2);
+                        end if;
+                        if (result /= std_logic_vector(to_unsigned(expected, 25))) then
+                            if (errors < 10) then
+                                report "test_stats: gate " & integer'image(k) & " counter " & integer'image(c) & ": " &
+                                       integer'image(to_integer(unsigned(result))) & ", expected " &
+                                       integer'image(expected) severity error;
+                            end if;
+                            errors := errors + 1;
+                        end if;
+                    end loop;
+                end if;
+            end if;
+        end loop;
+
+        report "test_stats: " & integer'image(latched) & " gates latched, " & integer'image(skipped) & " skipped, " &
+               integer'image(checked) & " checked";
+        if (last_gate /= gates) or (skipped = 0) or (checked = 0) then
+            errors := errors + 1;
+        end if;
+        assert errors = 0
+            report "test_stats: " & integer'image(errors) & " errors" severity failure;
+        report "test_stats: ok";
+        wait;
+    end process;
+
+end;
@@ -0,0 +1,303 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- throughput sweep of the whole design (runs with ghdl and the models in
+-- unisim_models.vhd, see "make bench-fpga")
+--
+-- mainmodule is configured over spi like the fx2 does and samples in the
+-- channel blocks encoding. the fx2 is modelled with the flowstate waveform
+-- reading at 48MHz into four 512 byte ep2 buffers, which usb empties at
+-- usb_rate. for each sample clock (100/160MHz) and number of channels the
+-- divisor is swept from slow to fast, each point runs for run_time and
+-- reports:
+--   the MB/s the fx2 received, the MB/s the fpga wrote into its fifo
+--   (telemetry words), the words dropped and the fifo high-water mark
+-- a point is sustained if nothing was dropped and the fifo didn't fall more
+-- than backlog_limit words behind. the sweep of a channel count stops at the
+-- first point which isn't, the first overflow point. the slowest point must
+-- be sustained
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+
+
+entity test_throughput is
+end test_throughput;
+
+architecture behavior of test_throughput is
+
+    type integer_arr_t is array (natural range <>) of integer;
+
+    -- sweep
+    constant channel_counts : integer_arr_t := (16, 8, 4, 2, 1);
+    constant divisors : integer_arr_t := (19, 15, 9, 7, 5, 4, 3, 2, 1, 0); -- slow to fast
+    constant run_time : time := 1 ms; -- per point
+    constant backlog_limit : integer := 3*1024; -- words, the fifo hands over whole block rams
+
+    -- fx2 model
+    constant gpif_latency : integer := 4; -- clocks from RDY0 to the read
+    constant ep2_buffers : integer := 4;
+    constant ep2_buffer_size : integer := 512;
+    constant usb_rate : real := 40.0e6; -- bytes/s the host takes from ep2
+
+    --Inputs
+    signal clk : std_logic := '0';
+    signal spi_ss_n : std_logic := '1';
+    signal spi_sclk : std_logic := '0';
+    signal spi_mosi : std_logic := '0';
+    signal fifo_read_n : std_logic := '1';
+    signal logic_data : std_logic_vector(15 downto 0) := (others=>'0');
+
+    --Outputs
+    signal led : std_logic;
+    signal spi_miso : std_logic;
+    signal fifo_empty : std_logic;
+    signal fifo_data : std_logic_vector(15 downto 0);
+
+    -- Clock period definitions
+    constant clk_period : time := 20.833 ns;
+    constant sclk_period : time := 250 ns;
+    constant usb_packet_time : time := real(ep2_buffer_size) / usb_rate * 1 sec;
+
+    signal done : boolean := false;
+    signal words_read : natural := 0; -- words the fx2 model read since the last clear
+    signal clear_words : boolean := false;
+
+begin
+
+    -- Instantiate the Unit Under Test (UUT)
+    uut: entity work.mainmodule
+        port map(
+            clk_in      => clk,
+            led         => led,
+            spi_ss_n    => spi_ss_n,
+            spi_sclk    => spi_sclk,
+            spi_mosi    => spi_mosi,
+            spi_miso    => spi_miso,
+            fifo_clk    => clk,
+            fifo_empty  => fifo_empty,
+            fifo_read_n => fifo_read_n,
+            fifo_data   => fifo_data,
+            logic_data  => logic_data
+        );
+
+    -- Clock process definitions
+    clk_process: process
+    begin
+        if done then
+            wait;
+        end if;
+        clk <= '0';
+        wait for clk_period/2;
+        clk <= '1';
+        wait for clk_period/2;
+    end process;
+
+    -- some activity on the inputs, the blocks encoding doesn't depend on it
+    logic_process: process
+    begin
+        if done then
+            wait;
+        end if;
+        logic_data <= std_logic_vector(unsigned(logic_data) + 1);
+        wait for 7 ns;
+    end process;
+
+    -- fx2 model: the flowstate waveform reads on every clock where RDY0 was
+    -- high gpif_latency clocks before and an ep2 buffer is free
+    fx2_proc: process(clk)
+        variable rdy_delay : std_logic_vector(15 downto 0) := (others=>'0');
+        variable bytes : natural := 0; -- in the buffer being filled
+        variable full_buffers : natural := 0; -- committed, waiting for usb
+        variable usb_busy_until : time := 0 ns;
+    begin
+        if rising_edge(clk) then
+            if (fifo_read_n = '0') then
+                words_read <= words_read + 1;
+                bytes := bytes + 2;
+                if (bytes = ep2_buffer_size) then
+                    bytes := 0;
+                    full_buffers := full_buffers + 1;
+                end if;
+            end if;
+            if clear_words then
+                words_read <= 0;
+            end if;
+
+            -- usb takes one packet per usb_packet_time
+            if (full_buffers > 0) and (now >= usb_busy_until) then
+                full_buffers := full_buffers - 1;
+                usb_busy_until := now + usb_packet_time;
+            end if;
+
+            rdy_delay := rdy_delay(14 downto 0) & not fifo_empty;
+            if (rdy_delay(gpif_latency-1) = '1') and (full_buffers < ep2_buffers) then
+                fifo_read_n <= '0';
+            else
+                fifo_read_n <= '1';
+            end if;
+        end if;
+    end process;
+
+    -- Stimulus process
+    stim_proc: process
+        type bytes_t is array (natural range <>) of unsigned(7 downto 0);
+        variable telemetry : bytes_t(0 to 14); -- ADDRESS_TELEMETRY_CONTROL to ADDRESS_TELEMETRY_SAMPLES+3
+
+        procedure spi_byte(tx : in unsigned(7 downto 0); rx : out unsigned(7 downto 0)) is
+        begin
+            for i in 0 to 7 loop
+                spi_mosi <= tx(7-i);
+                wait for sclk_period/2;
+                spi_sclk <= '1';
+                wait for sclk_period/2;
+                rx(7-i) := spi_miso;
+                spi_sclk <= '0';
+            end loop;
+        end spi_byte;
+
+        procedure spi_write(addr : in integer; data : in integer) is
+            variable rx : unsigned(7 downto 0);
+        begin
+            spi_ss_n <= '0';
+            wait for 2*sclk_period;
+            spi_byte('0' & to_unsigned(addr, 7), rx);
+            spi_byte(to_unsigned(data, 8), rx);
+            wait for 2*sclk_period;
+            spi_ss_n <= '1';
+            wait for 2*sclk_period;
+        end spi_write;
+
+        -- telemetry snapshot, then read all of it in one burst
+        procedure read_telemetry is
+        begin
+            spi_write(25, 0);
+            spi_ss_n <= '0';
+            wait for 2*sclk_period;
+            spi_byte('1' & to_unsigned(25, 7), telemetry(0));
+            for i in telemetry'range loop
+                spi_byte(x"00", telemetry(i));
+            end loop;
+            wait for 2*sclk_period;
+            spi_ss_n <= '1';
+            wait for 2*sclk_period;
+        end read_telemetry;
+
+        function le(b : bytes_t; first : natural; count : natural) return natural is
+            variable v : natural := 0;
+        begin
+            for i in count-1 downto 0 loop
+                v := v*256 + to_integer(b(first + i));
+            end loop;
+            return v;
+        end le;
+
+        -- one decimal place
+        function fmt(x : real) return string is
+        begin
+            return integer'image(integer(floor(x))) & "." & integer'image(integer(floor(x*10.0)) mod 10);
+        end fmt;
+
+        variable clock_mhz : integer;
+        variable channels : integer;
+        variable rate : real;
+        variable words, read_words, dropped, high_water : natural;
+        variable backlog : integer;
+        variable first_overflow : integer;
+        variable sustained : boolean;
+        variable start_time : time;
+        variable us : real; -- length of the run
+
+    begin
+        -- wait for internal reset
+        wait for clk_period*100;
+
+        for sel in 0 to 1 loop
+            if (sel = 0) then
+                clock_mhz := 100;
+            else
+                clock_mhz := 160;
+            end if;
+            for c in channel_counts'range loop
+                channels := channel_counts(c);
+                first_overflow := -1;
+                for d in divisors'range loop
+                    spi_write(1, 0); -- stop
+                    spi_write(2, (2**channels-1) mod 256);
+                    spi_write(3, (2**channels-1) / 256);
+                    spi_write(10, sel);
+                    spi_write(16, 0); -- channel blocks
+                    spi_write(40, 0);
+                    spi_write(41, 0);
+                    spi_write(4, divisors(d));
+                    wait for clk_period*20;
+                    clear_words <= true;
+                    wait until rising_edge(clk);
+                    clear_words <= false;
+                    spi_write(1, 1); -- run
+                    start_time := now;
+                    wait for run_time;
+                    read_words := words_read;
+                    us := real((now - start_time) / 1 ns) / 1000.0;
+                    read_telemetry;
+                    spi_write(1, 0);
+
+                    rate := real(clock_mhz) / real(divisors(d) + 1);
+                    words := le(telemetry, 7, 4);
+                    dropped := le(telemetry, 1, 4);
+                    high_water := le(telemetry, 5, 2);
+                    backlog := words - read_words;
+                    sustained := (dropped = 0) and (backlog <= backlog_limit);
+                    report "test_throughput: " & integer'image(clock_mhz) & "MHz, " &
+                           integer'image(channels) & " channels, " & fmt(rate) & " MS/s: " &
+                           "fx2 " & fmt(2.0 * real(read_words) / us) & " MB/s, " &
+                           "fifo in " & fmt(2.0 * real(words) / us) & " MB/s, " &
+                           integer'image(dropped) & " dropped, high-water " & integer'image(high_water) &
+                           ", behind " & integer'image(backlog);
+                    if not sustained then
+                        assert d /= divisors'low
+                            report "test_throughput: slowest rate not sustained" severity failure;
+                        first_overflow := d;
+                        exit;
+                    end if;
+                end loop;
+                if (first_overflow >= 0) then
+                    report "test_throughput: " & integer'image(clock_mhz) & "MHz, " &
+                           integer'image(channels) & " channels: first overflow at " &
+                           fmt(real(clock_mhz) / real(divisors(first_overflow) + 1)) & " MS/s (divisor " &
+                           integer'image(divisors(first_overflow)) & ")";
+                else
+                    report "test_throughput: " & integer'image(clock_mhz) & "MHz, " &
+                           integer'image(channels) & " channels: sustained up to the full sample clock";
+                end if;
+            end loop;
+        end loop;
+
+        done <= true;
+        wait;
+    end process;
+
+end;
@@ -0,0 +1,254 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- self checking testbench for the transitions unit (runs with ghdl, see "make sim")
+--
+-- the stimulus feeds a pseudo random sequence of runs into the encoder, a
+-- reference decoder sums up the timestamps of the records and compares the
+-- length of each run in ticks with the same sequence. at the end the input
+-- toggles on every clock, so records are refused (overflow), the decoder
+-- checks that the ticks up to the following steady run still add up
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity test_transitions is
+end test_transitions;
+
+architecture behavior of test_transitions is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+
+    constant run_count       : natural := 600; -- number of runs to send
+    constant full_rate_runs  : natural := 300; -- runs sent with a sample every clock
+    constant slow_rate       : natural := 3; -- clocks per sample for the other runs
+    constant long_run_index  : natural := 100; -- run longer than the maximum timestamp
+    constant dense_ticks     : natural := 300; -- clocks toggling the input at the end (even: the final value isn't refused)
+    constant dense_mask_a    : vector16_t := x"0100"; -- toggled values, xor'd with the last run
+    constant dense_mask_b    : vector16_t := x"0200";
+    constant final_mask      : vector16_t := x"0400"; -- steady value after the toggling
+
+    -- test data generator, used by stimulus and reference decoder
+    type gen_t is record
+        lfsr  : unsigned(31 downto 0);
+        value : vector16_t; -- value of the current run
+        ticks : natural; -- length of the current run in clocks
+        runs  : natural; -- number of runs started
+    end record;
+    constant gen_init : gen_t := (lfsr => x"87654321", value => (others=>'0'), ticks => 0, runs => 0);
+
+    procedure gen_run(g : inout gen_t) is
+        variable len : natural;
+    begin
+        for i in 0 to 7 loop
+            if (g.lfsr(0) = '1') then
+                g.lfsr := ('0' & g.lfsr(31 downto 1)) xor x"80200003";
+            else
+                g.lfsr := '0' & g.lfsr(31 downto 1);
+            end if;
+        end loop;
+        -- flip one or two channels
+        g.value(to_integer(g.lfsr(3 downto 0))) := not g.value(to_integer(g.lfsr(3 downto 0)));
+        if (g.lfsr(4) = '1') and (g.lfsr(8 downto 5) /= g.lfsr(3 downto 0)) then
+            g.value(to_integer(g.lfsr(8 downto 5))) := not g.value(to_integer(g.lfsr(8 downto 5)));
+        end if;
+        -- runs of at least two samples while sampling at full rate
+        len := 2 + to_integer(g.lfsr(12 downto 9));
+        if (g.runs = long_run_index) then
+            len := 150000;
+        elsif (g.runs mod 32 = 31) then
+            len := 1000;
+        end if;
+        if (g.runs < full_rate_runs) then
+            g.ticks := len;
+        else
+            g.ticks := len * slow_rate;
+        end if;
+        g.runs := g.runs + 1;
+    end gen_run;
+
+    --Inputs
+    signal clk : std_logic := '0';
+    signal enable : std_logic := '0';
+    signal data_mask : vector16_t := (others=>'1');
+    signal data_in : vector16_t := (others=>'0');
+    signal data_valid : std_logic := '0';
+
+    --Outputs
+    signal fifo_data : vector16_t;
+    signal fifo_write : std_logic;
+    signal overflow : std_logic;
+
+    -- Clock period definitions
+    constant clk_period : time := 10 ns;
+
+    signal done : boolean := false;
+    signal checked : natural := 0; -- runs checked by the reference decoder
+    signal dense_checked : boolean := false; -- ticks over the toggling added up
+    signal overflows : natural := 0;
+
+begin
+
+    -- Instantiate the Unit Under Test (UUT)
+    uut: entity work.transitions
+        port map(
+            clk        => clk,
+            enable     => enable,
+            data_mask  => data_mask,
+            data_in    => data_in,
+            data_valid => data_valid,
+            fifo_data  => fifo_data,
+            fifo_write => fifo_write,
+            overflow   => overflow
+        );
+
+    -- Clock process definitions
+    clk_process: process
+    begin
+        if done then
+            wait;
+        end if;
+        clk <= '0';
+        wait for clk_period/2;
+        clk <= '1';
+        wait for clk_period/2;
+    end process;
+
+    -- Stimulus process
+    stim_proc: process
+        variable g : gen_t := gen_init;
+        variable rate : natural;
+    begin
+        enable <= '0';
+        wait for clk_period*5;
+        wait until rising_edge(clk);
+        enable <= '1';
+
+        -- one more run than checked, it ends the last checked run
+        for r in 0 to run_count loop
+            gen_run(g);
+            if (g.runs <= full_rate_runs) then
+                rate := 1;
+            else
+                rate := slow_rate;
+            end if;
+            data_in <= g.value;
+            for t in 0 to g.ticks-1 loop
+                if (t mod rate = 0) then
+                    data_valid <= '1';
+                else
+                    data_valid <= '0';
+                end if;
+                wait until rising_edge(clk);
+            end loop;
+        end loop;
+
+        -- faster than records can be written
+        data_valid <= '1';
+        for t in 0 to dense_ticks-1 loop
+            if (t mod 2 = 0) then
+                data_in <= g.value xor dense_mask_a;
+            else
+                data_in <= g.value xor dense_mask_b;
+            end if;
+            wait until rising_edge(clk);
+        end loop;
+        data_in <= g.value xor final_mask;
+        wait for clk_period*10;
+        wait until rising_edge(clk);
+        data_valid <= '0';
+
+        wait for clk_period*20;
+        assert checked = run_count
+            report "checked " & integer'image(checked) & " runs, expected " & integer'image(run_count)
+            severity failure;
+        assert dense_checked and (overflows > 0)
+            report "toggling not checked, " & integer'image(overflows) & " overflows"
+            severity failure;
+        report "test_transitions: " & integer'image(checked) & " runs decoded ok, " &
+               integer'image(overflows) & " overflows while toggling";
+        done <= true;
+        wait;
+    end process;
+
+    -- reference decoder
+    check_proc: process(clk)
+        variable g : gen_t := gen_init;
+        variable value : vector16_t;
+        variable ticks : natural := 0; -- ticks of the current run
+        variable have_value : boolean := false;
+        variable started : boolean := false;
+        variable runs_checked : natural := 0;
+    begin
+        if rising_edge(clk) then
+            if (overflow = '1') then
+                assert runs_checked = run_count report "transitions overflow" severity failure;
+                overflows <= overflows + 1;
+            end if;
+            if (fifo_write = '1') then
+                if not have_value then
+                    value := fifo_data;
+                    have_value := true;
+                else
+                    have_value := false;
+                    ticks := ticks + to_integer(unsigned(fifo_data));
+                    if not started then
+                        -- first record holds the initial value
+                        assert unsigned(fifo_data) = 0 report "first record with timestamp" severity failure;
+                        gen_run(g);
+                        assert value = g.value report "wrong initial value" severity failure;
+                        started := true;
+                    elsif (runs_checked = run_count) then
+                        -- toggling: the records which were written must
+                        -- cover the last run and all of the toggling
+                        if (value = (g.value xor final_mask)) then
+                            assert ticks = g.ticks + dense_ticks
+                                report "toggling took " & integer'image(ticks) & " ticks, expected " &
+                                       integer'image(g.ticks + dense_ticks)
+                                severity failure;
+                            dense_checked <= true;
+                        end if;
+                    elsif (value /= g.value) then
+                        -- run ended, check its length
+                        assert ticks = g.ticks
+                            report "run " & integer'image(g.runs) & " is " & integer'image(ticks) &
+                                   " ticks long, expected " & integer'image(g.ticks)
+                            severity failure;
+                        runs_checked := runs_checked + 1;
+                        checked <= runs_checked;
+                        gen_run(g);
+                        assert value = g.value report "wrong value after run " & integer'image(g.runs-1) severity failure;
+                        ticks := 0;
+                    else
+                        -- extension record
+                        assert unsigned(fifo_data) = 2**16-1 report "short extension record" severity failure;
+                    end if;
+                end if;
+            end if;
+        end if;
+    end process;
+
+end;
@@ -0,0 +1,137 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- transition timestamp encoder for the sampled input words
+--
+-- a record of two fifo words is written whenever the input word changes:
+-- first the new input word, then the number of sample clock ticks since the
+-- previous record (the first record of a capture holds the initial input word
+-- and 0). if the input doesn't change for 65535 ticks an extension record with
+-- the unchanged input word and 65535 is written, so the time stays exact over
+-- arbitrarily long idle periods
+--
+-- writing a record takes two clocks and one record can be held while the
+-- previous one is written. if the input changes faster than that overflow is
+-- strobed and the change is taken from the next sample instead (it is lost
+-- if the input changed back), the ticks keep counting so the time stays exact
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity transitions is
+    port(
+        clk        : in std_logic; -- sample clock
+        enable     : in std_logic; -- '1' to encode, '0' to reset
+        data_mask  : in std_logic_vector(15 downto 0); -- unselected channels are read as '0', async (must only be changed while enable is inactive)
+        data_in    : in std_logic_vector(15 downto 0); -- sampled input word
+        data_valid : in std_logic; -- data_in holds a new sample
+        fifo_data  : out std_logic_vector(15 downto 0) := (others=>'0'); -- data to fifo
+        fifo_write : out std_logic := '0'; -- tell fifo to write data on next clock
+        overflow   : out std_logic := '0' -- strobed when a record was lost
+    );
+end transitions;
+
+
+architecture behavioral of transitions is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+
+    signal state       : vector16_t; -- last input word
+    signal state_valid : std_logic := '0'; -- first record has been written
+    signal ticks       : unsigned(15 downto 0); -- ticks since the last record
+    signal hold_value  : vector16_t; -- record waiting to be written
+    signal hold_ticks  : unsigned(15 downto 0);
+    signal hold_valid  : std_logic := '0';
+    signal write_ticks : std_logic := '0'; -- value was written, ticks are written next
+
+    attribute TIG : string;
+    attribute TIG of data_mask : signal is "TRUE";
+
+begin
+
+    process(clk)
+        variable value : vector16_t;
+        variable new_record : boolean;
+    begin
+        if rising_edge(clk) then
+            fifo_write <= '0';
+            overflow <= '0';
+
+            -- write held record to fifo, value first then ticks
+            if (write_ticks = '1') then
+                fifo_data <= std_logic_vector(hold_ticks);
+                fifo_write <= '1';
+                write_ticks <= '0';
+                hold_valid <= '0';
+            elsif (hold_valid = '1') then
+                fifo_data <= hold_value;
+                fifo_write <= '1';
+                write_ticks <= '1';
+            end if;
+
+            -- create record on change of the input or when ticks would wrap
+            value := data_in and data_mask;
+            new_record := false;
+            if (data_valid = '1') and ((state_valid = '0') or (value /= state)) then
+                new_record := true;
+            elsif (state_valid = '1') and (ticks = 2**ticks'length-1) then
+                -- extension record
+                new_record := true;
+                value := state;
+            end if;
+            if (state_valid = '1') then
+                ticks <= ticks + 1;
+            end if;
+            if new_record then
+                if (hold_valid = '0') or (write_ticks = '1') then
+                    -- hold is free or freed with this clock
+                    hold_value <= value;
+                    hold_ticks <= ticks;
+                    hold_valid <= '1';
+                    state <= value;
+                    state_valid <= '1';
+                    ticks <= to_unsigned(1, ticks'length);
+                else
+                    -- keep state and ticks, the next sample retries. the
+                    -- hold is free again after the next clock, so an
+                    -- extension record (no record for 65534 clocks) is
+                    -- never refused and ticks can't wrap
+                    overflow <= '1';
+                end if;
+            end if;
+
+            -- reset
+            if (enable = '0') then
+                state_valid <= '0';
+                ticks <= (others=>'0');
+                hold_valid <= '0';
+                write_ticks <= '0';
+                fifo_write <= '0';
+            end if;
+        end if;
+    end process;
+
+end behavioral;
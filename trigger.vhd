@@ -0,0 +1,136 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- multi stage trigger
+--
+-- each stage has a mask, a value and an edge bit per channel. channels with the
+-- mask bit set take part in the stage:
+--   edge = '0': channel must be at the level given by value
+--   edge = '1': channel must have a rising (value = '1') or falling (value = '0')
+--               edge, one edge on any of these channels is enough
+-- the stages must match one after the other (on different samples), the
+-- trigger fires when the last stage matched
+--
+-- hold is '1' while the trigger is enabled and did not fire yet
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity trigger is
+    generic(
+        stage_count_log2 : integer := 2
+    );
+    port(
+        clk        : in std_logic; -- sample clock
+        enable     : in std_logic; -- '1' to use the trigger, '0' to reset
+        run        : in std_logic; -- '1' while sampling
+        last_stage : in unsigned(stage_count_log2-1 downto 0); -- number of used stages - 1, async
+        mask       : in std_logic_vector(16*2**stage_count_log2-1 downto 0); -- 16 bits per stage, async
+        value      : in std_logic_vector(16*2**stage_count_log2-1 downto 0); -- 16 bits per stage, async
+        edge       : in std_logic_vector(16*2**stage_count_log2-1 downto 0); -- 16 bits per stage, async
+        data_in    : in std_logic_vector(15 downto 0); -- sampled input word
+        data_valid : in std_logic; -- data_in holds a new sample
+        hold       : out std_logic; -- waiting for the trigger
+        fired      : out std_logic; -- trigger fired
+        position   : out unsigned(31 downto 0) -- number of the sample which fired the trigger
+    );
+end trigger;
+
+
+architecture behavioral of trigger is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+    subtype stages_t is std_logic_vector(2**stage_count_log2-1 downto 0);
+
+    signal last_data    : vector16_t;
+    signal last_valid   : std_logic := '0'; -- last_data holds a sample
+    signal match        : stages_t; -- stage matched sample
+    signal match_valid  : std_logic := '0';
+    signal stage        : unsigned(stage_count_log2-1 downto 0);
+    signal fired_int    : std_logic := '0';
+    signal sample_count : unsigned(31 downto 0);
+
+    attribute TIG : string;
+    attribute TIG of last_stage : signal is "TRUE";
+    attribute TIG of mask : signal is "TRUE";
+    attribute TIG of value : signal is "TRUE";
+    attribute TIG of edge : signal is "TRUE";
+
+begin
+
+    hold <= enable and not fired_int;
+    fired <= fired_int;
+
+    process(clk)
+        variable m, v, e : vector16_t;
+        variable level_ok, edge_ok : boolean;
+    begin
+        if rising_edge(clk) then
+            -- compare sample with all stages
+            match_valid <= '0';
+            if (data_valid = '1') then
+                last_data <= data_in;
+                last_valid <= '1';
+                match_valid <= last_valid;
+                sample_count <= sample_count + 1;
+                for i in 0 to 2**stage_count_log2-1 loop
+                    m := mask(16*i+15 downto 16*i);
+                    v := value(16*i+15 downto 16*i);
+                    e := edge(16*i+15 downto 16*i);
+                    level_ok := ((data_in xor v) and m and not e) = x"0000";
+                    edge_ok := (m and e) = x"0000" or
+                               (((data_in and not last_data and v) or
+                                 (not data_in and last_data and not v)) and m and e) /= x"0000";
+                    match(i) <= '0';
+                    if level_ok and edge_ok then
+                        match(i) <= '1';
+                    end if;
+                end loop;
+            end if;
+
+            -- step through stages
+            if (match_valid = '1') and (fired_int = '0') and (match(to_integer(stage)) = '1') then
+                if (stage = last_stage) then
+                    fired_int <= '1';
+                    -- sample_count was incremented with the matching sample
+                    position <= sample_count - 1;
+                else
+                    stage <= stage + 1;
+                end if;
+            end if;
+
+            -- reset
+            if (enable = '0') or (run = '0') then
+                last_valid <= '0';
+                match_valid <= '0';
+                stage <= (others=>'0');
+                fired_int <= '0';
+                sample_count <= (others=>'0');
+            end if;
+        end if;
+    end process;
+
+end behavioral;
@@ -0,0 +1,121 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+----------------------------------------------------------------------------------
+--
+-- uart receiver for the protocol decoder, works on the sampled line
+--
+-- 8 data bits lsb first, optional parity, one stop bit, idle high. a frame
+-- starts with a falling edge, each bit is taken in its middle (bit_period / 2
+-- samples after the edge for the start bit, then every bit_period samples).
+-- a start bit which is high again in its middle is ignored. the byte is
+-- strobed in the middle of the stop bit with a framing error if the stop bit
+-- is low and a parity error if the parity doesn't match
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+
+entity uart_rx is
+    port(
+        clk        : in std_logic;
+        enable     : in std_logic; -- '1' to receive, '0' to reset
+        parity     : in std_logic_vector(1 downto 0); -- 0: none, 1: even, 2: odd, async (must only be changed while enable is inactive)
+        bit_period : in unsigned(15 downto 0); -- samples per bit, at least 2, async (must only be changed while enable is inactive)
+        rx         : in std_logic; -- line
+        data_valid : in std_logic; -- rx holds a new sample
+        data       : out std_logic_vector(7 downto 0) := (others=>'0');
+        flags      : out std_logic_vector(1 downto 0) := (others=>'0'); -- bit0: framing error, bit1: parity error
+        strobe     : out std_logic := '0' -- data and flags hold a received byte
+    );
+end uart_rx;
+
+
+architecture behavioral of uart_rx is
+
+    signal receiving  : std_logic := '0';
+    signal last_rx    : std_logic := '0';
+    signal count      : unsigned(15 downto 0); -- samples until the middle of the next bit
+    signal bit_index  : unsigned(3 downto 0); -- 0: start, 1-8: data, then parity and stop
+    signal shiftreg   : std_logic_vector(7 downto 0);
+    signal parity_acc : std_logic; -- xor of the data bits
+    signal stop_index : unsigned(3 downto 0); -- bit_index of the stop bit
+
+    attribute TIG : string;
+    attribute TIG of parity : signal is "TRUE";
+    attribute TIG of bit_period : signal is "TRUE";
+
+begin
+
+    stop_index <= to_unsigned(9, 4) when (parity = "00") else to_unsigned(10, 4);
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            strobe <= '0';
+            if (data_valid = '1') then
+                last_rx <= rx;
+                if (receiving = '0') then
+                    if (last_rx = '1') and (rx = '0') then
+                        -- start bit
+                        receiving <= '1';
+                        count <= ('0' & bit_period(15 downto 1)) - 1;
+                        bit_index <= (others=>'0');
+                        parity_acc <= '0';
+                    end if;
+                elsif (count /= 0) then
+                    count <= count - 1;
+                else
+                    count <= bit_period - 1;
+                    bit_index <= bit_index + 1;
+                    if (bit_index = 0) then
+                        if (rx = '1') then
+                            -- glitch, not a start bit
+                            receiving <= '0';
+                        end if;
+                    elsif (bit_index <= 8) then
+                        shiftreg <= rx & shiftreg(7 downto 1);
+                        parity_acc <= parity_acc xor rx;
+                    elsif (bit_index /= stop_index) then
+                        -- parity bit, even: the xor of all bits is 0
+                        flags(1) <= parity_acc xor rx xor parity(1);
+                    else
+                        data <= shiftreg;
+                        flags(0) <= not rx;
+                        if (parity = "00") then
+                            flags(1) <= '0';
+                        end if;
+                        strobe <= '1';
+                        receiving <= '0';
+                    end if;
+                end if;
+            end if;
+
+            -- reset, the line must be high before the first start bit
+            if (enable = '0') then
+                receiving <= '0';
+                last_rx <= '0';
+            end if;
+        end if;
+    end process;
+
+end behavioral;
@@ -0,0 +1,362 @@
+--
+-- This file is part of the la16fw project.
+--
+-- Copyright (C) 2014-2015 Gregor Anich
+--
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+--
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+--
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+--
+
+----------------------------------------------------------------------------------
+--
+-- simulation models of the xilinx primitives used by the design, so it can be
+-- simulated with ghdl without the xilinx libraries. "make sim" compiles this
+-- file into the library unisim, it is not part of the ise project
+--
+-- only what the design uses is modelled:
+--   DCM_SP:             CLK0 follows CLKIN, CLKFX runs at CLKIN_PERIOD *
+--                       CLKFX_DIVIDE / CLKFX_MULTIPLY (not phase locked to
+--                       CLKIN), LOCKED is set 16 CLKIN cycles after RST
+--   RAMB16BWE_S18_S18:  dual port ram, 1024x16 (no parity), write first
+--   IDDR2:              Q0 takes D on C0, Q1 on C1, with DDR_ALIGNMENT "C0"
+--                       Q1 is passed on at the next C0 (no CE, R, S)
+--
+----------------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+package vcomponents is
+
+    component DCM_SP
+        generic(
+            CLKDV_DIVIDE          : real := 2.0;
+            CLKFX_DIVIDE          : integer := 1;
+            CLKFX_MULTIPLY        : integer := 4;
+            CLKIN_DIVIDE_BY_2     : boolean := false;
+            CLKIN_PERIOD          : real := 10.0;
+            CLKOUT_PHASE_SHIFT    : string := "NONE";
+            CLK_FEEDBACK          : string := "1X";
+            DESKEW_ADJUST         : string := "SYSTEM_SYNCHRONOUS";
+            DLL_FREQUENCY_MODE    : string := "LOW";
+            DUTY_CYCLE_CORRECTION : boolean := true;
+            PHASE_SHIFT           : integer := 0;
+            STARTUP_WAIT          : boolean := false
+        );
+        port(
+            CLKIN    : in std_logic;
+            RST      : in std_logic;
+            CLKFB    : in std_logic;
+            PSCLK    : in std_logic;
+            PSEN     : in std_logic;
+            PSINCDEC : in std_logic;
+            CLK0     : out std_logic;
+            CLK90    : out std_logic;
+            CLK180   : out std_logic;
+            CLK270   : out std_logic;
+            CLK2X    : out std_logic;
+            CLK2X180 : out std_logic;
+            CLKDV    : out std_logic;
+            CLKFX    : out std_logic;
+            CLKFX180 : out std_logic;
+            LOCKED   : out std_logic;
+            STATUS   : out std_logic_vector(7 downto 0);
+            PSDONE   : out std_logic
+        );
+    end component;
+
+    component RAMB16BWE_S18_S18
+        generic(
+            INIT_A       : bit_vector(17 downto 0) := (others=>'0');
+            INIT_B       : bit_vector(17 downto 0) := (others=>'0');
+            SRVAL_A      : bit_vector(17 downto 0) := (others=>'0');
+            SRVAL_B      : bit_vector(17 downto 0) := (others=>'0');
+            WRITE_MODE_A : string := "WRITE_FIRST";
+            WRITE_MODE_B : string := "WRITE_FIRST"
+        );
+        port(
+            DOA   : out std_logic_vector(15 downto 0);
+            DOB   : out std_logic_vector(15 downto 0);
+            DOPA  : out std_logic_vector(1 downto 0);
+            DOPB  : out std_logic_vector(1 downto 0);
+            ADDRA : in std_logic_vector(9 downto 0);
+            ADDRB : in std_logic_vector(9 downto 0);
+            CLKA  : in std_logic;
+            CLKB  : in std_logic;
+            DIA   : in std_logic_vector(15 downto 0);
+            DIB   : in std_logic_vector(15 downto 0);
+            DIPA  : in std_logic_vector(1 downto 0);
+            DIPB  : in std_logic_vector(1 downto 0);
+            ENA   : in std_logic;
+            ENB   : in std_logic;
+            SSRA  : in std_logic;
+            SSRB  : in std_logic;
+            WEA   : in std_logic_vector(1 downto 0);
+            WEB   : in std_logic_vector(1 downto 0)
+        );
+    end component;
+
+    component IDDR2
+        generic(
+            DDR_ALIGNMENT : string := "NONE";
+            INIT_Q0       : bit := '0';
+            INIT_Q1       : bit := '0';
+            SRTYPE        : string := "SYNC"
+        );
+        port(
+            Q0 : out std_logic;
+            Q1 : out std_logic;
+            C0 : in std_logic;
+            C1 : in std_logic;
+            CE : in std_logic;
+            D  : in std_logic;
+            R  : in std_logic;
+            S  : in std_logic
+        );
+    end component;
+
+end vcomponents;
+
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity DCM_SP is
+    generic(
+        CLKDV_DIVIDE          : real := 2.0;
+        CLKFX_DIVIDE          : integer := 1;
+        CLKFX_MULTIPLY        : integer := 4;
+        CLKIN_DIVIDE_BY_2     : boolean := false;
+        CLKIN_PERIOD          : real := 10.0;
+        CLKOUT_PHASE_SHIFT    : string := "NONE";
+        CLK_FEEDBACK          : string := "1X";
+        DESKEW_ADJUST         : string := "SYSTEM_SYNCHRONOUS";
+        DLL_FREQUENCY_MODE    : string := "LOW";
+        DUTY_CYCLE_CORRECTION : boolean := true;
+        PHASE_SHIFT           : integer := 0;
+        STARTUP_WAIT          : boolean := false
+    );
+    port(
+        CLKIN    : in std_logic;
+        RST      : in std_logic;
+        CLKFB    : in std_logic;
+        PSCLK    : in std_logic;
+        PSEN     : in std_logic;
+        PSINCDEC : in std_logic;
+        CLK0     : out std_logic;
+        CLK90    : out std_logic;
+        CLK180   : out std_logic;
+        CLK270   : out std_logic;
+        CLK2X    : out std_logic;
+        CLK2X180 : out std_logic;
+        CLKDV    : out std_logic;
+        CLKFX    : out std_logic := '0';
+        CLKFX180 : out std_logic;
+        LOCKED   : out std_logic := '0';
+        STATUS   : out std_logic_vector(7 downto 0);
+        PSDONE   : out std_logic
+    );
+end DCM_SP;
+
+architecture behavioral of DCM_SP is
+
+    constant fx_half_period : time := CLKIN_PERIOD * 1 ns * real(CLKFX_DIVIDE) / real(CLKFX_MULTIPLY) / 2.0;
+
+    signal locked_int : std_logic := '0';
+    signal fx         : std_logic := '0';
+
+begin
+
+    CLK0 <= CLKIN;
+    CLK90 <= '0';
+    CLK180 <= not CLKIN;
+    CLK270 <= '0';
+    CLK2X <= '0';
+    CLK2X180 <= '0';
+    CLKDV <= '0';
+    CLKFX <= fx;
+    CLKFX180 <= not fx;
+    LOCKED <= locked_int;
+    STATUS <= (others=>'0');
+    PSDONE <= '0';
+
+    process(CLKIN, RST)
+        variable count : natural := 0;
+    begin
+        if (RST = '1') then
+            count := 0;
+            locked_int <= '0';
+        elsif rising_edge(CLKIN) then
+            if (count = 16) then
+                locked_int <= '1';
+            else
+                count := count + 1;
+            end if;
+        end if;
+    end process;
+
+    process
+    begin
+        if (RST = '1') then
+            fx <= '0';
+            wait until RST = '0';
+        end if;
+        fx <= '1';
+        wait for fx_half_period;
+        fx <= '0';
+        wait for fx_half_period;
+    end process;
+
+end behavioral;
+
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity RAMB16BWE_S18_S18 is
+    generic(
+        INIT_A       : bit_vector(17 downto 0) := (others=>'0');
+        INIT_B       : bit_vector(17 downto 0) := (others=>'0');
+        SRVAL_A      : bit_vector(17 downto 0) := (others=>'0');
+        SRVAL_B      : bit_vector(17 downto 0) := (others=>'0');
+        WRITE_MODE_A : string := "WRITE_FIRST";
+        WRITE_MODE_B : string := "WRITE_FIRST"
+    );
+    port(
+        DOA   : out std_logic_vector(15 downto 0);
+        DOB   : out std_logic_vector(15 downto 0);
+        DOPA  : out std_logic_vector(1 downto 0);
+        DOPB  : out std_logic_vector(1 downto 0);
+        ADDRA : in std_logic_vector(9 downto 0);
+        ADDRB : in std_logic_vector(9 downto 0);
+        CLKA  : in std_logic;
+        CLKB  : in std_logic;
+        DIA   : in std_logic_vector(15 downto 0);
+        DIB   : in std_logic_vector(15 downto 0);
+        DIPA  : in std_logic_vector(1 downto 0);
+        DIPB  : in std_logic_vector(1 downto 0);
+        ENA   : in std_logic;
+        ENB   : in std_logic;
+        SSRA  : in std_logic;
+        SSRB  : in std_logic;
+        WEA   : in std_logic_vector(1 downto 0);
+        WEB   : in std_logic_vector(1 downto 0)
+    );
+end RAMB16BWE_S18_S18;
+
+architecture behavioral of RAMB16BWE_S18_S18 is
+
+    subtype vector16_t is std_logic_vector(15 downto 0);
+    type mem_t is array (0 to 1023) of vector16_t;
+
+    signal doa_int : vector16_t := to_stdlogicvector(INIT_A(15 downto 0));
+    signal dob_int : vector16_t := to_stdlogicvector(INIT_B(15 downto 0));
+
+begin
+
+    DOA <= doa_int;
+    DOB <= dob_int;
+    DOPA <= (others=>'0');
+    DOPB <= (others=>'0');
+
+    -- one process for both ports, so the memory can be a variable
+    process(CLKA, CLKB)
+        variable mem : mem_t := (others=>(others=>'0'));
+
+        procedure port_access(
+            signal dout : out vector16_t;
+            addr : std_logic_vector(9 downto 0);
+            din  : std_logic_vector(15 downto 0);
+            we   : std_logic_vector(1 downto 0);
+            ssr  : std_logic;
+            srval : bit_vector(17 downto 0)) is
+            variable a : integer;
+        begin
+            a := to_integer(unsigned(addr));
+            for i in 0 to 1 loop
+                if (we(i) = '1') then
+                    mem(a)(8*i+7 downto 8*i) := din(8*i+7 downto 8*i);
+                end if;
+            end loop;
+            if (ssr = '1') then
+                dout <= to_stdlogicvector(srval(15 downto 0));
+            else
+                dout <= mem(a);
+            end if;
+        end port_access;
+    begin
+        if rising_edge(CLKA) and (ENA = '1') then
+            port_access(doa_int, ADDRA, DIA, WEA, SSRA, SRVAL_A);
+        end if;
+        if rising_edge(CLKB) and (ENB = '1') then
+            port_access(dob_int, ADDRB, DIB, WEB, SSRB, SRVAL_B);
+        end if;
+    end process;
+
+end behavioral;
+
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+entity IDDR2 is
+    generic(
+        DDR_ALIGNMENT : string := "NONE";
+        INIT_Q0       : bit := '0';
+        INIT_Q1       : bit := '0';
+        SRTYPE        : string := "SYNC"
+    );
+    port(
+        Q0 : out std_logic;
+        Q1 : out std_logic;
+        C0 : in std_logic;
+        C1 : in std_logic;
+        CE : in std_logic;
+        D  : in std_logic;
+        R  : in std_logic;
+        S  : in std_logic
+    );
+end IDDR2;
+
+architecture behavioral of IDDR2 is
+
+    -- one process drives each output, a second driver (even one which is
+    -- never assigned) would resolve Q1 to 'U'
+    signal q0_int : std_logic := to_stdulogic(INIT_Q0);
+    signal q1_int : std_logic := to_stdulogic(INIT_Q1);
+    signal q1_c1  : std_logic := to_stdulogic(INIT_Q1); -- taken at C1, moved to C0 with DDR_ALIGNMENT "C0"
+
+begin
+
+    Q0 <= q0_int;
+    Q1 <= q1_int;
+
+    process(C0, C1)
+    begin
+        if rising_edge(C0) then
+            q0_int <= D;
+            if (DDR_ALIGNMENT = "C0") then
+                q1_int <= q1_c1;
+            end if;
+        end if;
+        if rising_edge(C1) then
+            q1_c1 <= D;
+            if (DDR_ALIGNMENT /= "C0") then
+                q1_int <= D;
+            end if;
+        end if;
+    end process;
+
+end behavioral;